@@ -0,0 +1,163 @@
+// Time against accuracy of the compressed collectives (CollectiveCompression): for every
+// compression, the time of `multiplyTransposed` (an allreduce of the n x n result) and of
+// `sync_matrix` (a broadcast of an n x n matrix), the bytes that each process sends in their
+// collective, and the relative error (Frobenius norm) of the result against the uncompressed one.
+// The top-k reductions run with error feedback, over --steps products of the same matrices, and
+// the error is the one of the sum of their results.
+//
+//     mpirun -np 4 ./bench_compression --sizes 256,512 --output compression_np4.csv
+
+#include "bench_utils.hpp"
+#include "distributed_matrix.hpp"
+#include "matrix.hpp"
+#include <cmath>
+#include <mpi.h>
+
+namespace {
+
+double relativeError(const Matrix& value, const Matrix& exact)
+{
+    double error = 0.0, norm = 0.0;
+    const double* v = value.rawData();
+    const double* e = exact.rawData();
+    for (long k = 0; k < static_cast<long>(exact.numRows()) * exact.numCols(); k++) {
+        error += (v[k] - e[k]) * (v[k] - e[k]);
+        norm += e[k] * e[k];
+    }
+    return norm > 0.0 ? std::sqrt(error / norm) : std::sqrt(error);
+}
+
+struct CompressionResult
+{
+    std::string op;
+    int n = 0;
+    int procs = 1;
+    double seconds = 0.0;
+    double bytesSent = 0.0; // By each process in the collective
+    double relativeError = 0.0;
+};
+
+void writeResults(const bench::Options& options, const std::vector<CompressionResult>& results)
+{
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file)
+            throw std::runtime_error("Cannot open " + options.output);
+    }
+    std::ostream& out = options.output.empty() ? std::cout : file;
+    if (options.format == "json") {
+        out << "{\n  \"results\": [\n";
+        for (size_t k = 0; k < results.size(); k++) {
+            const CompressionResult& r = results[k];
+            out << "    {\"suite\": \"compression\", \"op\": \"" << r.op << "\", \"n\": " << r.n << ", \"procs\": "
+                << r.procs << ", \"seconds\": " << r.seconds << ", \"bytes_sent\": " << r.bytesSent
+                << ", \"relative_error\": " << r.relativeError << "}" << (k + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    } else {
+        out << "suite,op,n,procs,seconds,bytes_sent,relative_error\n";
+        for (const CompressionResult& r : results)
+            out << "compression," << r.op << "," << r.n << "," << r.procs << "," << r.seconds << "," << r.bytesSent
+                << "," << r.relativeError << "\n";
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    bench::Options options;
+    try {
+        options = bench::parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        if (rank == 0)
+            std::cerr << e.what() << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    using Kind = CollectiveCompression::Kind;
+    struct Variant
+    {
+        std::string name;
+        Kind kind;
+        double fraction;
+    };
+    const std::vector<Variant> variants = {{"none", Kind::None, 1.0},
+                                           {"float16", Kind::Float16, 1.0},
+                                           {"bfloat16", Kind::BFloat16, 1.0},
+                                           {"topk10", Kind::TopK, 0.1},
+                                           {"topk1", Kind::TopK, 0.01}};
+    const int steps = 10;
+
+    std::vector<CompressionResult> results;
+    for (int n : options.sizes) {
+        Matrix fullA = bench::randomMatrix(n, n, 1);
+        Matrix fullB = bench::randomMatrix(n, n, 2);
+        DistributedMatrix a(fullA, numProcs);
+        DistributedMatrix b(fullB, numProcs);
+        const Matrix exact = a.multiplyTransposed(b);
+        const double n2 = static_cast<double>(n) * n;
+
+        auto time = [&](const std::function<void()>& body) {
+            double seconds = bench::timeOperation(body, options.minTime, [] { MPI_Barrier(MPI_COMM_WORLD); },
+                                                  [](bool again) {
+                                                      int any = again;
+                                                      MPI_Allreduce(MPI_IN_PLACE, &any, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+                                                      return any != 0;
+                                                  });
+            double slowest;
+            MPI_Allreduce(&seconds, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            return slowest;
+        };
+        auto report = [&](const CompressionResult& r) {
+            results.push_back(r);
+            if (rank == 0)
+                std::cerr << r.op << " n=" << n << " procs=" << numProcs << ": " << r.seconds << " s, "
+                          << r.bytesSent << " bytes, error " << r.relativeError << std::endl;
+        };
+
+        for (const Variant& variant : variants) {
+            const long keep = std::max(1L, static_cast<long>(std::ceil(variant.fraction * n2)));
+            const double bytesSent = variant.kind == Kind::None     ? sizeof(double) * n2
+                                     : variant.kind == Kind::TopK ? (sizeof(int64_t) + sizeof(double)) * keep
+                                                                  : sizeof(uint16_t) * n2;
+
+            // Accuracy: the sum of `steps` products against `steps` times the exact one
+            CollectiveCompression compression(variant.kind, variant.fraction);
+            Matrix sum(n, n);
+            sum.fill(0.0);
+            for (int step = 0; step < steps; step++)
+                sum = sum + a.multiplyTransposed(b, compression);
+            CompressionResult r;
+            r.op = "multiplyTransposed_" + variant.name;
+            r.n = n;
+            r.procs = numProcs;
+            r.relativeError = relativeError(sum, exact * static_cast<double>(steps));
+            r.seconds = time([&] { a.multiplyTransposed(b, compression); });
+            r.bytesSent = bytesSent;
+            report(r);
+
+            if (variant.kind == Kind::TopK)
+                continue;
+            Matrix synced = rank == 0 ? fullA : Matrix(n, n);
+            sync_matrix(&synced, rank, 0, compression);
+            r.op = "sync_matrix_" + variant.name;
+            r.relativeError = relativeError(synced, fullA);
+            r.seconds = time([&] { sync_matrix(&synced, rank, 0, compression); });
+            report(r);
+        }
+    }
+
+    if (rank == 0)
+        writeResults(options, results);
+
+    MPI_Finalize();
+    return 0;
+}
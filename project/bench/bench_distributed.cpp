@@ -0,0 +1,112 @@
+// Benchmark of every operation of the `DistributedMatrix` API for a sweep of sizes.
+// The number of processes is the one given to `mpirun`; the roofline is the aggregate
+// of the roofline measured concurrently by every process.
+//
+//     mpirun -np 4 ./bench_distributed --sizes 256,512 --format csv --output distributed_np4.csv
+
+#include "bench_utils.hpp"
+#include "distributed_matrix.hpp"
+#include "matrix.hpp"
+#include <mpi.h>
+
+int main(int argc, char** argv)
+{
+    int provided; // Local Matrix operations run on OpenMP threads, MPI calls on this one only
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    bench::Options options;
+    try {
+        options = bench::parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        if (rank == 0)
+            std::cerr << e.what() << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    bench::Roofline roofline = bench::measureRoofline();
+    MPI_Allreduce(MPI_IN_PLACE, &roofline.peakGflops, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &roofline.bandwidthGBs, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0)
+        std::cerr << "Aggregate roofline: " << roofline.peakGflops << " Gflop/s (" << roofline.isa << "), "
+                  << roofline.bandwidthGBs << " GB/s" << std::endl;
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    std::vector<bench::Result> results;
+    for (int n : options.sizes) {
+        Matrix fullA = bench::randomMatrix(n, n, 1);
+        Matrix fullB = bench::randomMatrix(n, n, 2);
+        DistributedMatrix a(fullA, numProcs);
+        DistributedMatrix b(fullB, numProcs);
+        DistributedMatrix c(a);
+        Matrix full(n, n);
+        const double n2 = static_cast<double>(n) * n;
+        const double word = sizeof(double);
+        volatile double sink = 0.0;
+
+        auto run = [&](const std::string& op, double flops, double bytes, const std::function<void()>& body) {
+            bench::Result r;
+            r.suite = "distributed";
+            r.op = op;
+            r.n = n;
+            r.threads = threads;
+            r.procs = numProcs;
+            double seconds = bench::timeOperation(body, options.minTime, [] { MPI_Barrier(MPI_COMM_WORLD); },
+                                                  [](bool again) {
+                                                      int any = again;
+                                                      MPI_Allreduce(MPI_IN_PLACE, &any, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+                                                      return any != 0;
+                                                  });
+            // The slowest process determines the time of a collective operation
+            MPI_Allreduce(&seconds, &r.seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            r.flops = flops;
+            r.bytes = bytes;
+            results.push_back(r);
+            if (rank == 0)
+                std::cerr << op << " n=" << n << " procs=" << numProcs << ": " << r.seconds << " s" << std::endl;
+        };
+
+        run("fill", 0, word * n2, [&] { c.fill(1.0); });
+        run("add", n2, 3 * word * n2, [&] { c = a + b; });
+        run("sub", n2, 3 * word * n2, [&] { c = a - b; });
+        run("scale", n2, 2 * word * n2, [&] { c = a * 2.0; });
+        run("sub_mul", 2 * n2, 3 * word * n2, [&] { c.sub_mul(1e-3, a); });
+        run("apply", n2, 2 * word * n2, [&] { c = a.apply([](double x) { return x * x; }); });
+        run("applyBinary", n2, 3 * word * n2,
+            [&] { c = DistributedMatrix::applyBinary(a, b, [](double x, double y) { return x * y; }); });
+        run("applyInPlace", 2 * n2, 2 * word * n2, [&] { c.applyInPlace([](double x) { return 0.5 * x + 0.25; }); });
+        // Update step with a leaky ReLU: a temporary and two passes, against a single fused pass
+        auto leaky = [](double x) { return x > 0.0 ? x : 0.01 * x; };
+        run("update_sub_mul_apply", 3 * n2, 5 * word * n2, [&] { c.sub_mul(1e-3, a.apply(leaky)); });
+        run("update_axpby", 4 * n2, 3 * word * n2, [&] { c.axpby(-1e-3, a, 1.0, leaky); });
+        run("sum", n2, word * n2, [&] { sink = a.sum(); });
+        run("gather", 0, (1 + numProcs) * word * n2, [&] { full = a.gather(); });
+        run("transpose", 0, (2 + numProcs) * word * n2, [&] { full = a.transpose(); });
+        run("multiply", 2 * n2 * n, (2 + numProcs) * word * n2, [&] { c = multiply(fullA, b); });
+        NodeSharedMatrix sharedA(fullA, 0);
+        NodeSharedMatrix sharedFull(full, 0);
+        run("multiplyShared", 2 * n2 * n, 3 * word * n2, [&] { c = multiply(sharedA, b); });
+        run("multiplyTransposed", 2 * n2 * n, (2 + numProcs) * word * n2, [&] { full = a.multiplyTransposed(b); });
+        run("multiplyTransposedShared", 2 * n2 * n, 3 * word * n2, [&] { sharedFull = a.multiplyTransposedShared(b); });
+        run("multiplyTransposedDistributed", 2 * n2 * n, 4 * word * n2, [&] { c = a.multiplyTransposedDistributed(b); });
+        run("sync_matrix", 0, numProcs * word * n2, [&] { sync_matrix(&full, rank, 0); });
+        run("MatrixBroadcast", 0, numProcs * word * n2, [&] {
+            MatrixBroadcast bcast(&full, rank, 0);
+            for (int s = 0; s < bcast.numSegments(); s++)
+                bcast.waitSegment(s);
+        });
+    }
+
+    if (rank == 0)
+        bench::writeResults(options, roofline, results);
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,185 @@
+// Performance regression gate for the `Matrix` kernels.
+//
+// Runs a fixed set of benchmarks `--runs` times, summarizes each one with its median, MAD
+// and the 95% confidence interval of the median, and compares them with a baseline:
+//
+//     ./bench_gate --write-baseline bench/baseline.json   # Record the baseline
+//     ./bench_gate --baseline bench/baseline.json         # Exit with 1 if an op regressed
+//
+// An op regresses if its median is slower than the baseline by more than `--tolerance`
+// (relative) and by more than `--noise-factor` times the relative noise (scaled MAD) of the
+// noisier of the two measurements, and the confidence intervals of the medians do not overlap.
+
+#include "bench_stats.hpp"
+#include "bench_utils.hpp"
+#include "json_reader.hpp"
+#include "matrix.hpp"
+#include <iomanip>
+#include <map>
+
+namespace {
+
+struct GateOptions {
+    std::string baseline;
+    std::string writeBaseline;
+    int runs = 15;
+    double tolerance = 0.10;
+    double noiseFactor = 3.0;
+    double minTime = 0.05;
+};
+
+GateOptions parseGateOptions(int argc, char** argv)
+{
+    GateOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+            throw std::invalid_argument("Missing value for " + arg);
+        std::string value = argv[++i];
+        if (arg == "--baseline")
+            options.baseline = value;
+        else if (arg == "--write-baseline")
+            options.writeBaseline = value;
+        else if (arg == "--runs")
+            options.runs = std::stoi(value);
+        else if (arg == "--tolerance")
+            options.tolerance = std::stod(value);
+        else if (arg == "--noise-factor")
+            options.noiseFactor = std::stod(value);
+        else if (arg == "--min-time")
+            options.minTime = std::stod(value);
+        else
+            throw std::invalid_argument("Unknown option " + arg);
+    }
+    if (options.baseline.empty() == options.writeBaseline.empty())
+        throw std::invalid_argument("Exactly one of --baseline and --write-baseline is required");
+    if (options.runs < 3)
+        throw std::invalid_argument("--runs must be at least 3");
+    return options;
+}
+
+struct Benchmark {
+    std::string op;
+    int n;
+    std::function<void()> body;
+    std::string key() const { return op + "/" + std::to_string(n); }
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    GateOptions options;
+    try {
+        options = parseGateOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    Matrix a256 = bench::randomMatrix(256, 256, 1), b256 = bench::randomMatrix(256, 256, 2);
+    Matrix a512 = bench::randomMatrix(512, 512, 1), b512 = bench::randomMatrix(512, 512, 2);
+    Matrix a1024 = bench::randomMatrix(1024, 1024, 1), b1024 = bench::randomMatrix(1024, 1024, 2);
+    Matrix c(1, 1);
+
+    const std::vector<Benchmark> benchmarks = {
+        {"gemm", 256, [&] { c = a256 * b256; }},
+        {"gemm", 512, [&] { c = a512 * b512; }},
+        {"transpose", 512, [&] { c = a512.transpose(); }},
+        {"transpose", 1024, [&] { c = a1024.transpose(); }},
+        {"add", 1024, [&] { c = a1024 + b1024; }},
+        {"scale", 1024, [&] { c = a1024 * 2.0; }},
+        {"sub_mul", 1024, [&] { a1024.sub_mul(1e-9, b1024); }},
+        {"apply", 1024, [&] { c = a1024.apply([](double x) { return x * x; }); }},
+        {"fill", 1024, [&] { c.fill(1.0); }},
+    };
+
+    std::map<std::string, bench::Summary> current;
+    for (const Benchmark& b : benchmarks) {
+        if (b.op == "fill")
+            c = Matrix(b.n, b.n);
+        std::vector<double> samples;
+        for (int run = 0; run < options.runs; run++)
+            samples.push_back(bench::timeOperation(b.body, options.minTime));
+        current[b.key()] = bench::summarize(samples);
+        std::cerr << b.key() << ": median " << current[b.key()].median << " s" << std::endl;
+    }
+
+    if (!options.writeBaseline.empty()) {
+        std::ofstream out(options.writeBaseline);
+        if (!out) {
+            std::cerr << "Cannot open " << options.writeBaseline << std::endl;
+            return 2;
+        }
+        out << std::setprecision(9);
+        out << "{\n  \"cpu\": \"" << bench::hostCpuModel() << "\",\n  \"threads\": " << threads
+            << ",\n  \"benchmarks\": [\n";
+        for (size_t k = 0; k < benchmarks.size(); k++) {
+            const bench::Summary& s = current[benchmarks[k].key()];
+            out << "    {\"op\": \"" << benchmarks[k].op << "\", \"n\": " << benchmarks[k].n
+                << ", \"runs\": " << s.runs << ", \"median\": " << s.median << ", \"mad\": " << s.mad
+                << ", \"ci_low\": " << s.ciLow << ", \"ci_high\": " << s.ciHigh << "}"
+                << (k + 1 < benchmarks.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        std::cout << "Baseline written to " << options.writeBaseline << std::endl;
+        return 0;
+    }
+
+    bench::Json baseline;
+    try {
+        baseline = bench::readJsonFile(options.baseline);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+    if (baseline["cpu"].string != bench::hostCpuModel())
+        std::cout << "Warning: the baseline was recorded on \"" << baseline["cpu"].string
+                  << "\", not on this host (\"" << bench::hostCpuModel() << "\")" << std::endl;
+    if (static_cast<int>(baseline["threads"].number) != threads)
+        std::cout << "Warning: the baseline was recorded with " << baseline["threads"].number
+                  << " threads, this run uses " << threads << std::endl;
+
+    std::map<std::string, bench::Summary> reference;
+    for (const bench::Json& entry : baseline["benchmarks"].array) {
+        bench::Summary s;
+        s.runs = static_cast<int>(entry["runs"].number);
+        s.median = entry["median"].number;
+        s.mad = entry["mad"].number;
+        s.ciLow = entry["ci_low"].number;
+        s.ciHigh = entry["ci_high"].number;
+        reference[entry["op"].string + "/" + std::to_string(static_cast<int>(entry["n"].number))] = s;
+    }
+
+    int regressions = 0;
+    std::cout << std::left << std::setw(16) << "benchmark" << std::right << std::setw(14) << "baseline (s)"
+              << std::setw(14) << "current (s)" << std::setw(9) << "ratio" << std::setw(9) << "allowed"
+              << "  verdict" << std::endl;
+    for (const Benchmark& b : benchmarks) {
+        const bench::Summary& now = current[b.key()];
+        std::cout << std::left << std::setw(16) << b.key() << std::right;
+        auto it = reference.find(b.key());
+        if (it == reference.end()) {
+            std::cout << std::setw(14) << "-" << std::setw(14) << now.median << "  new (not in baseline)" << std::endl;
+            continue;
+        }
+        bench::Comparison cmp = bench::compare(it->second, now, options.tolerance, options.noiseFactor);
+        regressions += cmp.regression;
+        std::cout << std::setw(14) << it->second.median << std::setw(14) << now.median << std::fixed
+                  << std::setprecision(3) << std::setw(9) << cmp.ratio << std::setw(9) << 1.0 + cmp.allowed
+                  << std::defaultfloat << std::setprecision(6) << "  "
+                  << (cmp.regression ? "REGRESSION" : (cmp.ratio < 1.0 - cmp.allowed ? "faster" : "ok")) << std::endl;
+    }
+
+    if (regressions > 0) {
+        std::cout << regressions << " benchmark(s) regressed." << std::endl;
+        return 1;
+    }
+    std::cout << "No performance regression." << std::endl;
+    return 0;
+}
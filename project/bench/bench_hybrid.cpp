@@ -0,0 +1,101 @@
+// Pure MPI against hybrid MPI + OpenMP on one node: the same matrices and operations, with
+// either one single-threaded process per core or one process per socket whose local Matrix
+// operations run on OpenMP threads (MPI initialized with MPI_THREAD_FUNNELED).
+//
+//     OMP_NUM_THREADS=1 mpirun -np <cores> --bind-to core ./bench_hybrid --output hybrid_mpi.csv
+//     export OMP_NUM_THREADS=<cores per socket> OMP_PLACES=cores OMP_PROC_BIND=close
+//     mpirun -np <sockets> --map-by socket:PE=<cores per socket> ./bench_hybrid --output hybrid_omp.csv
+//
+// (`make run_bench_hybrid` runs both.) Fewer processes mean fewer copies of the replicated
+// left operand of `multiply` and smaller collectives, at the price of the OpenMP overheads.
+
+#include "bench_utils.hpp"
+#include "distributed_matrix.hpp"
+#include "matrix.hpp"
+#include <mpi.h>
+
+int main(int argc, char** argv)
+{
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    bench::Options options;
+    try {
+        options = bench::parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        if (rank == 0)
+            std::cerr << e.what() << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    if (rank == 0 && threads > 1 && provided < MPI_THREAD_FUNNELED)
+        std::cerr << "Warning: the MPI library does not support MPI_THREAD_FUNNELED" << std::endl;
+
+    bench::Roofline roofline = bench::measureRoofline();
+    MPI_Allreduce(MPI_IN_PLACE, &roofline.peakGflops, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &roofline.bandwidthGBs, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0)
+        std::cerr << numProcs << " processes x " << threads << " threads, aggregate roofline: "
+                  << roofline.peakGflops << " Gflop/s (" << roofline.isa << "), " << roofline.bandwidthGBs
+                  << " GB/s" << std::endl;
+
+    std::vector<bench::Result> results;
+    for (int n : options.sizes) {
+        Matrix fullA = bench::randomMatrix(n, n, 1);
+        Matrix fullB = bench::randomMatrix(n, n, 2);
+        DistributedMatrix a(fullA, numProcs);
+        DistributedMatrix b(fullB, numProcs);
+        DistributedMatrix blockA(fullA, numProcs, DistributedMatrix::Layout::BlockCyclic);
+        DistributedMatrix blockB(fullB, numProcs, DistributedMatrix::Layout::BlockCyclic);
+        DistributedMatrix c(a), blockC(blockA);
+        Matrix full(n, n);
+        const double n2 = static_cast<double>(n) * n;
+        const double word = sizeof(double);
+        volatile double sink = 0.0;
+
+        auto run = [&](const std::string& op, double flops, double bytes, const std::function<void()>& body) {
+            bench::Result r;
+            r.suite = "hybrid";
+            r.op = op;
+            r.n = n;
+            r.threads = threads;
+            r.procs = numProcs;
+            double seconds = bench::timeOperation(body, options.minTime, [] { MPI_Barrier(MPI_COMM_WORLD); },
+                                                  [](bool again) {
+                                                      int any = again;
+                                                      MPI_Allreduce(MPI_IN_PLACE, &any, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+                                                      return any != 0;
+                                                  });
+            MPI_Allreduce(&seconds, &r.seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            r.flops = flops;
+            r.bytes = bytes;
+            results.push_back(r);
+            if (rank == 0)
+                std::cerr << op << " n=" << n << " " << numProcs << "x" << threads << ": " << r.seconds << " s, "
+                          << r.gflops() << " Gflop/s" << std::endl;
+        };
+
+        // `multiply` replicates the left operand on every process: numProcs copies of it
+        run("multiply", 2 * n2 * n, (2 + numProcs) * word * n2, [&] { c = multiply(fullA, b); });
+        run("multiplyTransposed", 2 * n2 * n, (2 + numProcs) * word * n2, [&] { full = a.multiplyTransposed(b); });
+        run("summa", 2 * n2 * n, 3 * word * n2, [&] { blockC = blockA * blockB; });
+        run("add", n2, 3 * word * n2, [&] { c = a + b; });
+        run("sub_mul", 2 * n2, 3 * word * n2, [&] { c.sub_mul(1e-3, a); });
+        run("sum", n2, word * n2, [&] { sink = a.sum(); });
+        run("gather", 0, (1 + numProcs) * word * n2, [&] { full = a.gather(); });
+    }
+
+    if (rank == 0)
+        bench::writeResults(options, roofline, results);
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Benchmark of every operation of the common `Matrix` API for a sweep of sizes and
+// numbers of OpenMP threads. Each result is positioned on the host roofline.
+//
+//     ./bench_matrix --sizes 128,256,512 --threads 1,2,4 --format json --output matrix.json
+
+#include "bench_utils.hpp"
+#include "matrix.hpp"
+
+int main(int argc, char** argv)
+{
+    bench::Options options;
+    try {
+        options = bench::parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<int> threadCounts = options.threads;
+    if (threadCounts.empty()) {
+#ifdef _OPENMP
+        threadCounts.push_back(omp_get_max_threads());
+#else
+        threadCounts.push_back(1);
+#endif
+    }
+
+    bench::Roofline roofline = bench::measureRoofline();
+    std::cerr << "Host roofline: " << roofline.peakGflops << " Gflop/s (" << roofline.isa << "), "
+              << roofline.bandwidthGBs << " GB/s" << std::endl;
+
+    std::vector<bench::Result> results;
+    for (int threads : threadCounts) {
+#ifdef _OPENMP
+        omp_set_num_threads(threads);
+#endif
+        for (int n : options.sizes) {
+            Matrix a = bench::randomMatrix(n, n, 1);
+            Matrix b = bench::randomMatrix(n, n, 2);
+            Matrix c(n, n);
+            const double n2 = static_cast<double>(n) * n;
+            const double word = sizeof(double);
+
+            auto run = [&](const std::string& op, double flops, double bytes, const std::function<void()>& body) {
+                bench::Result r;
+                r.suite = "matrix";
+                r.op = op;
+                r.n = n;
+                r.threads = threads;
+                r.seconds = bench::timeOperation(body, options.minTime);
+                r.flops = flops;
+                r.bytes = bytes;
+                results.push_back(r);
+                std::cerr << op << " n=" << n << " threads=" << threads << ": " << r.seconds << " s" << std::endl;
+            };
+
+            run("fill", 0, word * n2, [&] { c.fill(1.0); });
+            run("add", n2, 3 * word * n2, [&] { c = a + b; });
+            run("sub", n2, 3 * word * n2, [&] { c = a - b; });
+            run("scale", n2, 2 * word * n2, [&] { c = a * 2.0; });
+            run("sub_mul", 2 * n2, 3 * word * n2, [&] { c.sub_mul(1e-3, a); });
+            run("transpose", 0, 2 * word * n2, [&] { c = a.transpose(); });
+            run("apply", n2, 2 * word * n2, [&] { c = a.apply([](double x) { return x * x; }); });
+            run("gemm", 2 * n2 * n, 3 * word * n2, [&] { c = a * b; });
+        }
+    }
+
+    bench::writeResults(options, roofline, results);
+    return 0;
+}
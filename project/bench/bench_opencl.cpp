@@ -0,0 +1,140 @@
+// Benchmark of every operation of the `MatrixCL` API for a sweep of sizes.
+// The roofline is the one of the OpenCL device (single precision), measured with a
+// copy kernel for the bandwidth and a kernel of independent FMA chains for the peak.
+//
+//     ./bench_opencl --sizes 256,512,1024 --format csv --output opencl.csv
+
+#include "bench_utils.hpp"
+#include "matrix_opencl.hpp"
+
+namespace {
+
+const std::string roofline_source = R"(
+    __kernel void copy(__global const float4* src, __global float4* dst) {
+        int i = get_global_id(0);
+        dst[i] = src[i];
+    }
+
+    __kernel void fma_chains(__global float* out, int iters) {
+        float a0 = get_global_id(0), a1 = a0 + 1, a2 = a0 + 2, a3 = a0 + 3;
+        float a4 = a0 + 4, a5 = a0 + 5, a6 = a0 + 6, a7 = a0 + 7;
+        for (int it = 0; it < iters; it++) {
+            a0 = fma(a0, 0.999999f, 1e-7f); a1 = fma(a1, 0.999999f, 1e-7f);
+            a2 = fma(a2, 0.999999f, 1e-7f); a3 = fma(a3, 0.999999f, 1e-7f);
+            a4 = fma(a4, 0.999999f, 1e-7f); a5 = fma(a5, 0.999999f, 1e-7f);
+            a6 = fma(a6, 0.999999f, 1e-7f); a7 = fma(a7, 0.999999f, 1e-7f);
+        }
+        out[get_global_id(0)] = a0 + a1 + a2 + a3 + a4 + a5 + a6 + a7;
+    }
+)";
+
+bench::Roofline measureDeviceRoofline(cl::Context context, cl::CommandQueue queue, const cl::Device& device)
+{
+    cl::Program program(context, roofline_source);
+    program.build({device});
+    bench::Roofline roofline;
+    roofline.isa = "opencl";
+
+    const size_t numFloat4 = 1 << 24; // 256 MiB per buffer
+    cl::Buffer src(context, CL_MEM_READ_WRITE, numFloat4 * 4 * sizeof(float));
+    cl::Buffer dst(context, CL_MEM_READ_WRITE, numFloat4 * 4 * sizeof(float));
+    cl::Kernel copy(program, "copy");
+    copy.setArg(0, src);
+    copy.setArg(1, dst);
+    double seconds = bench::timeOperation(
+        [&] { queue.enqueueNDRangeKernel(copy, cl::NullRange, cl::NDRange(numFloat4)); }, 0.2,
+        [&] { queue.finish(); });
+    roofline.bandwidthGBs = 2.0 * numFloat4 * 4 * sizeof(float) / seconds / 1e9;
+
+    const size_t workItems = 1 << 20;
+    const int iters = 1024;
+    cl::Buffer out(context, CL_MEM_WRITE_ONLY, workItems * sizeof(float));
+    cl::Kernel chains(program, "fma_chains");
+    chains.setArg(0, out);
+    chains.setArg(1, iters);
+    seconds = bench::timeOperation(
+        [&] { queue.enqueueNDRangeKernel(chains, cl::NullRange, cl::NDRange(workItems)); }, 0.2,
+        [&] { queue.finish(); });
+    roofline.peakGflops = 2.0 * 8 * iters * workItems / seconds / 1e9;
+    return roofline;
+}
+
+std::vector<float> randomData(int rows, int cols, unsigned seed)
+{
+    std::vector<float> data(static_cast<size_t>(rows) * cols);
+    for (float& x : data)
+        x = static_cast<float>(bench::randomValue(seed));
+    return data;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bench::Options options;
+    try {
+        options = bench::parseOptions(argc, argv);
+
+        std::vector<cl::Platform> platforms;
+        cl::Platform::get(&platforms);
+        if (platforms.empty())
+            throw std::runtime_error("No OpenCL platform found");
+        std::vector<cl::Device> devices;
+        platforms.front().getDevices(CL_DEVICE_TYPE_GPU, &devices);
+        if (devices.empty())
+            platforms.front().getDevices(CL_DEVICE_TYPE_CPU, &devices);
+        if (devices.empty())
+            throw std::runtime_error("No OpenCL device found");
+        cl::Device device = devices.front();
+        std::cerr << "Device: " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+
+        cl::Context context(device);
+        cl::CommandQueue queue(context, device);
+        MatrixCL::initializeKernels(context, {device});
+
+        bench::Roofline roofline = measureDeviceRoofline(context, queue, device);
+        std::cerr << "Device roofline: " << roofline.peakGflops << " Gflop/s (fp32), "
+                  << roofline.bandwidthGBs << " GB/s" << std::endl;
+
+        std::vector<bench::Result> results;
+        for (int n : options.sizes) {
+            std::vector<float> dataA = randomData(n, n, 1);
+            std::vector<float> dataB = randomData(n, n, 2);
+            MatrixCL a(n, n, context, queue, &dataA);
+            MatrixCL b(n, n, context, queue, &dataB);
+            MatrixCL c(n, n, context, queue);
+            const double n2 = static_cast<double>(n) * n;
+            const double word = sizeof(float);
+
+            auto run = [&](const std::string& op, double flops, double bytes, const std::function<void()>& body) {
+                bench::Result r;
+                r.suite = "opencl";
+                r.op = op;
+                r.n = n;
+                r.seconds = bench::timeOperation(body, options.minTime, [&] { queue.finish(); });
+                r.flops = flops;
+                r.bytes = bytes;
+                results.push_back(r);
+                std::cerr << op << " n=" << n << ": " << r.seconds << " s" << std::endl;
+            };
+
+            run("fill", 0, word * n2, [&] { c.fill(1.0f); });
+            run("add", n2, 3 * word * n2, [&] { c = a + b; });
+            run("sub", n2, 3 * word * n2, [&] { c = a - b; });
+            run("scale", n2, 2 * word * n2, [&] { c = a * 2.0f; });
+            run("sub_mul", 2 * n2, 3 * word * n2, [&] { c.sub_mul(1e-3f, a); });
+            run("transpose", 0, 2 * word * n2, [&] { c = a.transpose(); });
+            run("gemm", 2 * n2 * n, 3 * word * n2, [&] { c = a * b; });
+            run("copyToHost", 0, word * n2, [&] { (void)a.copyToHost(); });
+        }
+
+        bench::writeResults(options, roofline, results);
+    } catch (const cl::Error& err) {
+        std::cerr << "OpenCL Error: " << err.what() << " (" << err.err() << ")" << std::endl;
+        return 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
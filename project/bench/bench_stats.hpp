@@ -0,0 +1,79 @@
+#ifndef BENCH_STATS_HPP
+#define BENCH_STATS_HPP
+
+// Robust statistics of repeated benchmark runs, used by the regression gate.
+// Timings are skewed (a run can only be slowed down by noise), so we use the median and
+// the median absolute deviation (MAD) instead of the mean and the standard deviation.
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace bench {
+
+struct Summary {
+    int runs = 0;
+    double median = 0.0;
+    double mad = 0.0;    // Median absolute deviation
+    double ciLow = 0.0;  // 95% confidence interval of the median
+    double ciHigh = 0.0;
+
+    // MAD scaled to estimate the standard deviation of normal data, relative to the median
+    double relativeNoise() const { return median > 0 ? 1.4826 * mad / median : 0.0; }
+};
+
+inline double median(std::vector<double> values)
+{
+    if (values.empty())
+        throw std::invalid_argument("median of an empty sample");
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+inline Summary summarize(const std::vector<double>& samples)
+{
+    Summary s;
+    s.runs = static_cast<int>(samples.size());
+    s.median = median(samples);
+    std::vector<double> deviations;
+    for (double x : samples)
+        deviations.push_back(std::fabs(x - s.median));
+    s.mad = median(deviations);
+
+    // Distribution-free interval: the number of samples below the median is Binomial(n, 1/2),
+    // so the order statistics at n/2 -+ 1.96 sqrt(n)/2 bracket the median with 95% confidence.
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    int n = s.runs;
+    int low = static_cast<int>(std::floor(n / 2.0 - 1.96 * std::sqrt(n) / 2.0));
+    int high = static_cast<int>(std::ceil(n / 2.0 + 1.96 * std::sqrt(n) / 2.0));
+    s.ciLow = sorted[std::max(low, 0)];
+    s.ciHigh = sorted[std::min(high, n - 1)];
+    return s;
+}
+
+// Verdict of the comparison of a benchmark against its baseline
+struct Comparison {
+    double ratio = 1.0;     // current median / baseline median
+    double allowed = 0.0;   // Relative slowdown tolerated given the noise of both measurements
+    bool regression = false;
+};
+
+// An op regresses if it is slower than the baseline by more than `tolerance` and by more
+// than `noiseFactor` times the relative noise of the noisier measurement, and if the
+// confidence intervals of the two medians do not overlap.
+inline Comparison compare(const Summary& baseline, const Summary& current,
+                          double tolerance, double noiseFactor)
+{
+    Comparison c;
+    c.ratio = current.median / baseline.median;
+    c.allowed = std::max(tolerance, noiseFactor * std::max(baseline.relativeNoise(), current.relativeNoise()));
+    c.regression = c.ratio - 1.0 > c.allowed && current.ciLow > baseline.ciHigh;
+    return c;
+}
+
+} // namespace bench
+
+#endif // BENCH_STATS_HPP
@@ -0,0 +1,91 @@
+// Weak scaling of the distributed matrix product: the global size grows with the number of
+// processes so that every process stores the same amount of data (n_local x n_local
+// elements of each operand, with n_local given by --sizes). For each size, it compares
+// the SUMMA product of two block-cyclic matrices with `multiply`, which replicates the
+// left operand on every process.
+//
+//     for np in 1 4 16 64; do mpirun -np $np ./bench_summa --sizes 256 --output summa_np$np.csv; done
+//
+// With perfect weak scaling the time per process stays constant up to the sqrt(P) growth
+// of the flops per process (a product of n x n matrices costs 2 n^3 flops).
+
+#include "bench_utils.hpp"
+#include "distributed_matrix.hpp"
+#include "matrix.hpp"
+#include <cmath>
+#include <mpi.h>
+
+int main(int argc, char** argv)
+{
+    int provided; // Local Matrix operations run on OpenMP threads, MPI calls on this one only
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    bench::Options options;
+    try {
+        options = bench::parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        if (rank == 0)
+            std::cerr << e.what() << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    bench::Roofline roofline = bench::measureRoofline();
+    MPI_Allreduce(MPI_IN_PLACE, &roofline.peakGflops, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &roofline.bandwidthGBs, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    std::vector<bench::Result> results;
+    for (int nLocal : options.sizes) {
+        const int n = static_cast<int>(std::lround(nLocal * std::sqrt(static_cast<double>(numProcs))));
+        Matrix fullA = bench::randomMatrix(n, n, 1);
+        Matrix fullB = bench::randomMatrix(n, n, 2);
+        DistributedMatrix a(fullA, numProcs, DistributedMatrix::Layout::BlockCyclic);
+        DistributedMatrix b(fullB, numProcs, DistributedMatrix::Layout::BlockCyclic);
+        DistributedMatrix columnsB(fullB, numProcs);
+        DistributedMatrix c(a), columnsC(columnsB);
+        const double n2 = static_cast<double>(n) * n;
+        const double word = sizeof(double);
+        const ProcessGrid& grid = a.getGrid();
+
+        auto run = [&](const std::string& op, double flops, double bytes, const std::function<void()>& body) {
+            bench::Result r;
+            r.suite = "summa";
+            r.op = op;
+            r.n = n;
+            r.threads = threads;
+            r.procs = numProcs;
+            double seconds = bench::timeOperation(body, options.minTime, [] { MPI_Barrier(MPI_COMM_WORLD); },
+                                                  [](bool again) {
+                                                      int any = again;
+                                                      MPI_Allreduce(MPI_IN_PLACE, &any, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+                                                      return any != 0;
+                                                  });
+            MPI_Allreduce(&seconds, &r.seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            r.flops = flops;
+            r.bytes = bytes;
+            results.push_back(r);
+            if (rank == 0)
+                std::cerr << op << " n=" << n << " (" << grid.rows << " x " << grid.cols << " grid): " << r.seconds
+                          << " s, " << r.gflops() / numProcs << " Gflop/s per process" << std::endl;
+        };
+
+        // SUMMA moves each operand sqrt(P) times in total; `multiply` needs the whole
+        // left operand and moves nothing else.
+        run("summa", 2 * n2 * n, (3 + grid.rows + grid.cols) * word * n2, [&] { c = a * b; });
+        run("multiply", 2 * n2 * n, (2 + numProcs) * word * n2, [&] { columnsC = multiply(fullA, columnsB); });
+    }
+
+    if (rank == 0)
+        bench::writeResults(options, roofline, results);
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Training of a multilayer perceptron (--sizes: width n of its layers, 4n samples) by gradient
+// descent with the two distributions of Part 3, question 3:
+//  - "columns": the samples are the columns of a DistributedMatrix and the weights are
+//    replicated; every layer multiplies its weights by the distributed activations (`multiply`)
+//    and gets its gradient with `multiplyTransposed`, a blocking allreduce per layer;
+//  - "dataParallel": every process holds the rows (samples) of its shard in a local Matrix and
+//    runs the whole network on it, and the gradients are averaged by a GradientSynchronizer
+//    whose bucketed MPI_Iallreduce overlap with the backpropagation of the earlier layers;
+//  - "dataParallelOneBucket": the same with a single bucket, i.e. without that overlap.
+//
+//     mpirun -np 4 ./bench_training --sizes 256,512 --output training_np4.csv
+//
+// A run is one step (forward, backward and update of all the weights).
+
+#include "bench_utils.hpp"
+#include "distributed_matrix.hpp"
+#include "matrix.hpp"
+#include <cmath>
+#include <mpi.h>
+
+namespace {
+
+const int layers = 4;
+
+// Gradient with respect to z of a tanh layer, given the gradient g with respect to tanh(z)
+double tanhBackward(double g, double z)
+{
+    const double t = std::tanh(z);
+    return g * (1.0 - t * t);
+}
+
+// One step with the samples as the columns of DistributedMatrix objects
+void columnsStep(std::vector<Matrix>& weights, const DistributedMatrix& x, const DistributedMatrix& y, double learningRate)
+{
+    std::vector<DistributedMatrix> z, a{x};
+    for (int l = 0; l < layers; l++) {
+        z.push_back(multiply(weights[l], a.back()));
+        a.push_back(l + 1 < layers ? z.back().apply([](double v) { return std::tanh(v); }) : z.back());
+    }
+    DistributedMatrix delta = (a.back() - y) * (1.0 / x.numCols());
+    for (int l = layers - 1; l >= 0; l--) {
+        Matrix gradient = delta.multiplyTransposed(a[l]);
+        if (l > 0)
+            delta = DistributedMatrix::applyBinary(multiply(weights[l].transpose(), delta), z[l - 1], tanhBackward);
+        weights[l].sub_mul(learningRate, gradient);
+    }
+}
+
+// One step with the samples as the rows of a local Matrix
+void dataParallelStep(std::vector<Matrix>& weights, std::vector<Matrix>& gradients, const Matrix& x, const Matrix& y,
+                      int totalSamples, double learningRate, long bucketBytes)
+{
+    int numProcs;
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+    std::vector<Matrix*> parameters, gradientPointers;
+    for (int l = layers - 1; l >= 0; l--) { // In the order of backpropagation
+        parameters.push_back(&weights[l]);
+        gradientPointers.push_back(&gradients[l]);
+    }
+
+    dataParallelGradientDescent(parameters, gradientPointers, learningRate, 1, [&](GradientSynchronizer& sync) {
+        std::vector<Matrix> z, a{x};
+        for (int l = 0; l < layers; l++) {
+            z.push_back(a.back() * weights[l].transpose());
+            a.push_back(l + 1 < layers ? z.back().apply([](double v) { return std::tanh(v); }) : z.back());
+        }
+        // The average over the processes of the gradients of the shards is the gradient of the mean loss
+        Matrix delta = (a.back() - y) * (static_cast<double>(numProcs) / totalSamples);
+        for (int l = layers - 1; l >= 0; l--) {
+            gradients[l] = delta.transpose() * a[l];
+            sync.ready(layers - 1 - l);
+            if (l > 0) {
+                delta = delta * weights[l];
+                double* d = delta.rawData();
+                const double* zl = z[l - 1].rawData();
+                for (long k = 0; k < static_cast<long>(delta.numRows()) * delta.numCols(); k++)
+                    d[k] = tanhBackward(d[k], zl[k]);
+            }
+        }
+    }, bucketBytes);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int provided; // Local Matrix operations run on OpenMP threads, MPI calls on this one only
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    bench::Options options;
+    try {
+        options = bench::parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        if (rank == 0)
+            std::cerr << e.what() << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    bench::Roofline roofline = bench::measureRoofline();
+    MPI_Allreduce(MPI_IN_PLACE, &roofline.peakGflops, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &roofline.bandwidthGBs, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0)
+        std::cerr << "Aggregate roofline: " << roofline.peakGflops << " Gflop/s (" << roofline.isa << "), "
+                  << roofline.bandwidthGBs << " GB/s" << std::endl;
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    const double learningRate = 1e-3;
+    std::vector<bench::Result> results;
+    for (int n : options.sizes) {
+        const int samples = 4 * n;
+        Matrix fullX = bench::randomMatrix(samples, n, 1);
+        Matrix fullY = bench::randomMatrix(samples, n, 2);
+        std::vector<Matrix> weights, gradients;
+        for (int l = 0; l < layers; l++) {
+            weights.push_back(bench::randomMatrix(n, n, 3 + l) * (1.0 / std::sqrt(n)));
+            gradients.emplace_back(n, n);
+        }
+
+        DistributedMatrix columnsX(fullX.transpose(), numProcs);
+        DistributedMatrix columnsY(fullY.transpose(), numProcs);
+        // The rows of this process: a block as equal as possible
+        const int first = static_cast<int>(static_cast<long>(samples) * rank / numProcs);
+        const int last = static_cast<int>(static_cast<long>(samples) * (rank + 1) / numProcs);
+        Matrix shardX(last - first, n), shardY(last - first, n);
+        std::copy(fullX.rawData() + static_cast<long>(first) * n, fullX.rawData() + static_cast<long>(last) * n, shardX.rawData());
+        std::copy(fullY.rawData() + static_cast<long>(first) * n, fullY.rawData() + static_cast<long>(last) * n, shardY.rawData());
+
+        const double n2 = static_cast<double>(n) * n;
+        const double word = sizeof(double);
+        auto run = [&](const std::string& op, const std::function<void()>& body) {
+            bench::Result r;
+            r.suite = "training";
+            r.op = op;
+            r.n = n;
+            r.threads = threads;
+            r.procs = numProcs;
+            double seconds = bench::timeOperation(body, options.minTime, [] { MPI_Barrier(MPI_COMM_WORLD); },
+                                                  [](bool again) {
+                                                      int any = again;
+                                                      MPI_Allreduce(MPI_IN_PLACE, &any, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+                                                      return any != 0;
+                                                  });
+            MPI_Allreduce(&seconds, &r.seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            // Forward, then the gradients of the weights and of the activations: 3 products per layer
+            r.flops = 3 * 2 * n2 * samples * layers;
+            // Samples, targets, weights and the activations kept for backpropagation
+            r.bytes = word * (2 * n2 * layers + (2 + 2 * layers) * static_cast<double>(samples) * n);
+            results.push_back(r);
+            if (rank == 0)
+                std::cerr << op << " n=" << n << " procs=" << numProcs << ": " << r.seconds << " s, "
+                          << r.gflops() << " Gflop/s" << std::endl;
+        };
+
+        run("columns", [&] { columnsStep(weights, columnsX, columnsY, learningRate); });
+        run("dataParallel", [&] { dataParallelStep(weights, gradients, shardX, shardY, samples, learningRate, 0); });
+        run("dataParallelOneBucket",
+            [&] { dataParallelStep(weights, gradients, shardX, shardY, samples, learningRate, 1L << 40); });
+    }
+
+    if (rank == 0)
+        bench::writeResults(options, roofline, results);
+
+    MPI_Finalize();
+    return 0;
+}
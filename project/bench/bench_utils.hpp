@@ -0,0 +1,355 @@
+#ifndef BENCH_UTILS_HPP
+#define BENCH_UTILS_HPP
+
+// Shared helpers of the benchmark programs in `bench/`:
+//  - command-line parsing (`--sizes 128,256 --threads 1,2,4 --format csv --output file`),
+//  - timing of an operation,
+//  - measurement of the host roofline (STREAM triad bandwidth and peak FMA throughput),
+//  - CSV / JSON output of the results positioned on that roofline,
+//  - reproducible pseudo-random inputs.
+
+#include "matrix.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace bench {
+
+// --- Command line ---
+
+struct Options {
+    std::vector<int> sizes = {64, 128, 256, 512, 1024};
+    std::vector<int> threads;            // Empty: only the default number of threads
+    std::string format = "csv";          // "csv" or "json"
+    std::string output;                  // Empty: standard output
+    double minTime = 0.2;                // Minimum total time spent on each measurement (seconds)
+};
+
+inline std::vector<int> parseList(const std::string& text)
+{
+    std::vector<int> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty())
+            values.push_back(std::stoi(item));
+    return values;
+}
+
+inline Options parseOptions(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+            throw std::invalid_argument("Missing value for " + arg);
+        std::string value = argv[++i];
+        if (arg == "--sizes")
+            options.sizes = parseList(value);
+        else if (arg == "--threads")
+            options.threads = parseList(value);
+        else if (arg == "--format")
+            options.format = value;
+        else if (arg == "--output")
+            options.output = value;
+        else if (arg == "--min-time")
+            options.minTime = std::stod(value);
+        else
+            throw std::invalid_argument("Unknown option " + arg);
+    }
+    if (options.format != "csv" && options.format != "json")
+        throw std::invalid_argument("--format must be csv or json");
+    return options;
+}
+
+// --- Timing ---
+
+inline double now()
+{
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+// Runs `op` once to warm up, then repeatedly until `minTime` seconds have elapsed
+// (and at least 3 times) and returns the median time of one run in seconds.
+// `sync` is called after each run, e.g. to wait for a GPU queue or an MPI barrier.
+// `agree` turns the local "run again?" decision into a decision shared by all the
+// processes taking part in a collective operation, so they all run it the same number of times.
+inline double timeOperation(const std::function<void()>& op, double minTime,
+                            const std::function<void()>& sync = [] {},
+                            const std::function<bool(bool)>& agree = [](bool again) { return again; })
+{
+    op();
+    sync();
+    std::vector<double> times;
+    double start = now();
+    while (agree(times.size() < 3 || now() - start < minTime)) {
+        double t0 = now();
+        op();
+        sync();
+        times.push_back(now() - t0);
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// --- Host ---
+
+// "model name" of the first CPU in /proc/cpuinfo ("unknown" if not available)
+inline std::string hostCpuModel()
+{
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos && colon + 2 <= line.size())
+                return line.substr(colon + 2);
+        }
+    return "unknown";
+}
+
+// --- Roofline ---
+
+struct Roofline {
+    double peakGflops = 0.0;    // Double-precision FMA throughput (1 FMA = 2 flops)
+    double bandwidthGBs = 0.0;  // STREAM triad bandwidth
+    std::string isa = "scalar"; // Instruction set used for the FMA measurement
+
+    // Minimal time needed to execute `flops` floating-point operations moving `bytes` bytes
+    double boundTime(double flops, double bytes) const
+    {
+        return std::max(flops / (peakGflops * 1e9), bytes / (bandwidthGBs * 1e9));
+    }
+};
+
+// Each call performs `iters` iterations of independent FMA chains on one core.
+// Enough chains are in flight to hide the FMA latency (4 cycles x 2 ports on recent cores).
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx512f"))) inline double fmaChainsAvx512(long iters)
+{
+    __m512d acc[12];
+    const __m512d a = _mm512_set1_pd(0.999999), b = _mm512_set1_pd(1e-7);
+    for (int c = 0; c < 12; c++)
+        acc[c] = _mm512_set1_pd(c);
+    for (long it = 0; it < iters; it++)
+        for (int c = 0; c < 12; c++)
+            acc[c] = _mm512_fmadd_pd(acc[c], a, b);
+    double out[8], s = 0.0;
+    for (int c = 0; c < 12; c++) {
+        _mm512_storeu_pd(out, acc[c]);
+        for (double x : out)
+            s += x;
+    }
+    return s;
+}
+
+__attribute__((target("avx2,fma"))) inline double fmaChainsAvx2(long iters)
+{
+    __m256d acc[12];
+    const __m256d a = _mm256_set1_pd(0.999999), b = _mm256_set1_pd(1e-7);
+    for (int c = 0; c < 12; c++)
+        acc[c] = _mm256_set1_pd(c);
+    for (long it = 0; it < iters; it++)
+        for (int c = 0; c < 12; c++)
+            acc[c] = _mm256_fmadd_pd(acc[c], a, b);
+    double out[4], s = 0.0;
+    for (int c = 0; c < 12; c++) {
+        _mm256_storeu_pd(out, acc[c]);
+        for (double x : out)
+            s += x;
+    }
+    return s;
+}
+#endif
+
+inline double fmaChainsScalar(long iters)
+{
+    double acc[12];
+    for (int c = 0; c < 12; c++)
+        acc[c] = c;
+    for (long it = 0; it < iters; it++)
+        for (int c = 0; c < 12; c++)
+            acc[c] = std::fma(acc[c], 0.999999, 1e-7);
+    double s = 0.0;
+    for (double x : acc)
+        s += x;
+    return s;
+}
+
+// Peak FMA throughput of all the threads of this process, in Gflop/s
+inline double measurePeakGflops(std::string& isa)
+{
+    std::function<double(long)> kernel = fmaChainsScalar;
+    int width = 1;
+    isa = "scalar";
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx512f")) {
+        kernel = fmaChainsAvx512;
+        width = 8;
+        isa = "avx512";
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        kernel = fmaChainsAvx2;
+        width = 4;
+        isa = "avx2";
+    }
+#endif
+    const long iters = 20000000 / width;
+    double best = 0.0;
+    for (int rep = 0; rep < 3; rep++) {
+        double sink = 0.0;
+        int numThreads = 1;
+        double t0 = now();
+#pragma omp parallel reduction(+ : sink)
+        {
+#ifdef _OPENMP
+#pragma omp single
+            numThreads = omp_get_num_threads();
+#endif
+            sink += kernel(iters);
+        }
+        double elapsed = now() - t0;
+        if (sink == 42.0) // Prevent the compiler from discarding the computation
+            std::cerr << sink;
+        best = std::max(best, 2.0 * 12 * width * iters * numThreads / elapsed / 1e9);
+    }
+    return best;
+}
+
+// STREAM triad `a = b + s * c` on arrays much larger than the last-level cache, in GB/s
+inline double measureBandwidthGBs()
+{
+    const long n = 1L << 23; // 3 arrays of 64 MiB
+    std::vector<double> a(n), b(n), c(n);
+    double* pa = a.data();
+    double* pb = b.data();
+    double* pc = c.data();
+    // First touch by the threads that will use the pages
+#pragma omp parallel for schedule(static)
+    for (long k = 0; k < n; k++) {
+        pa[k] = 0.0;
+        pb[k] = 1.0;
+        pc[k] = 2.0;
+    }
+    double best = 0.0;
+    for (int rep = 0; rep < 5; rep++) {
+        double t0 = now();
+#pragma omp parallel for schedule(static)
+        for (long k = 0; k < n; k++)
+            pa[k] = pb[k] + 3.0 * pc[k];
+        best = std::max(best, 3.0 * sizeof(double) * n / (now() - t0) / 1e9);
+    }
+    return best;
+}
+
+inline Roofline measureRoofline()
+{
+    Roofline roofline;
+    roofline.peakGflops = measurePeakGflops(roofline.isa);
+    roofline.bandwidthGBs = measureBandwidthGBs();
+    return roofline;
+}
+
+// --- Inputs ---
+
+// Pseudo-random value in [-0.5, 0.5) from a linear congruential generator: the same sequence
+// on every process, compiler and run
+inline double randomValue(unsigned& seed)
+{
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 16) / 65536.0 - 0.5;
+}
+
+inline Matrix randomMatrix(int rows, int cols, unsigned seed)
+{
+    Matrix m(rows, cols);
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++)
+            m.set(i, j, randomValue(seed));
+    return m;
+}
+
+// --- Results ---
+
+struct Result {
+    std::string suite;  // "matrix", "distributed" or "opencl"
+    std::string op;
+    int n = 0;          // Matrices are n x n
+    int threads = 1;
+    int procs = 1;
+    double seconds = 0.0;
+    double flops = 0.0; // Floating-point operations of one run
+    double bytes = 0.0; // Compulsory memory traffic of one run
+
+    double gflops() const { return flops / seconds / 1e9; }
+    double gbytesPerSecond() const { return bytes / seconds / 1e9; }
+    double intensity() const { return bytes > 0 ? flops / bytes : 0.0; }
+    // Fraction of the roofline bound that is achieved, between 0 and 1
+    double efficiency(const Roofline& roofline) const { return roofline.boundTime(flops, bytes) / seconds; }
+    // "compute" if the op would be limited by the FMA peak, "memory" if by the bandwidth
+    std::string bound(const Roofline& roofline) const
+    {
+        return flops / (roofline.peakGflops * 1e9) >= bytes / (roofline.bandwidthGBs * 1e9) ? "compute" : "memory";
+    }
+};
+
+inline void writeCsv(std::ostream& out, const Roofline& roofline, const std::vector<Result>& results)
+{
+    out << "# peak_gflops=" << roofline.peakGflops << " bandwidth_gbs=" << roofline.bandwidthGBs
+        << " isa=" << roofline.isa << "\n";
+    out << "suite,op,n,threads,procs,seconds,gflops,gbytes_per_s,intensity,bound,efficiency\n";
+    for (const Result& r : results)
+        out << r.suite << "," << r.op << "," << r.n << "," << r.threads << "," << r.procs << ","
+            << r.seconds << "," << r.gflops() << "," << r.gbytesPerSecond() << "," << r.intensity() << ","
+            << r.bound(roofline) << "," << r.efficiency(roofline) << "\n";
+}
+
+inline void writeJson(std::ostream& out, const Roofline& roofline, const std::vector<Result>& results)
+{
+    out << "{\n  \"roofline\": {\"peak_gflops\": " << roofline.peakGflops
+        << ", \"bandwidth_gbs\": " << roofline.bandwidthGBs << ", \"isa\": \"" << roofline.isa << "\"},\n"
+        << "  \"results\": [\n";
+    for (size_t k = 0; k < results.size(); k++) {
+        const Result& r = results[k];
+        out << "    {\"suite\": \"" << r.suite << "\", \"op\": \"" << r.op << "\", \"n\": " << r.n
+            << ", \"threads\": " << r.threads << ", \"procs\": " << r.procs << ", \"seconds\": " << r.seconds
+            << ", \"gflops\": " << r.gflops() << ", \"gbytes_per_s\": " << r.gbytesPerSecond()
+            << ", \"intensity\": " << r.intensity() << ", \"bound\": \"" << r.bound(roofline)
+            << "\", \"efficiency\": " << r.efficiency(roofline) << "}" << (k + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+inline void writeResults(const Options& options, const Roofline& roofline, const std::vector<Result>& results)
+{
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file)
+            throw std::runtime_error("Cannot open " + options.output);
+    }
+    std::ostream& out = options.output.empty() ? std::cout : file;
+    if (options.format == "json")
+        writeJson(out, roofline, results);
+    else
+        writeCsv(out, roofline, results);
+}
+
+} // namespace bench
+
+#endif // BENCH_UTILS_HPP
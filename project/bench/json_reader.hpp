@@ -0,0 +1,166 @@
+#ifndef JSON_READER_HPP
+#define JSON_READER_HPP
+
+// Minimal JSON reader for the files written by the benchmark programs (e.g. the baseline
+// of the regression gate). It supports objects, arrays, strings without unicode escapes,
+// numbers, booleans and null, which is all these files contain.
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+struct Json {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Json> array;
+    std::map<std::string, Json> object;
+
+    const Json& operator[](const std::string& key) const
+    {
+        auto it = object.find(key);
+        if (type != Type::Object || it == object.end())
+            throw std::runtime_error("JSON: missing key \"" + key + "\"");
+        return it->second;
+    }
+    bool has(const std::string& key) const { return type == Type::Object && object.count(key) > 0; }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : text(text), pos(0) {}
+
+    Json parse()
+    {
+        Json value = parseValue();
+        skipSpaces();
+        if (pos != text.size())
+            fail("trailing characters");
+        return value;
+    }
+
+private:
+    const std::string& text;
+    size_t pos;
+
+    [[noreturn]] void fail(const std::string& what) const
+    {
+        throw std::runtime_error("JSON: " + what + " at offset " + std::to_string(pos));
+    }
+
+    void skipSpaces()
+    {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+            pos++;
+    }
+
+    void expect(char c)
+    {
+        skipSpaces();
+        if (pos >= text.size() || text[pos] != c)
+            fail(std::string("expected '") + c + "'");
+        pos++;
+    }
+
+    bool consume(const std::string& word)
+    {
+        if (text.compare(pos, word.size(), word) != 0)
+            return false;
+        pos += word.size();
+        return true;
+    }
+
+    std::string parseString()
+    {
+        expect('"');
+        std::string s;
+        while (pos < text.size() && text[pos] != '"') {
+            if (text[pos] == '\\' && pos + 1 < text.size())
+                pos++;
+            s += text[pos++];
+        }
+        expect('"');
+        return s;
+    }
+
+    Json parseValue()
+    {
+        skipSpaces();
+        if (pos >= text.size())
+            fail("unexpected end");
+        Json value;
+        char c = text[pos];
+        if (c == '{') {
+            value.type = Json::Type::Object;
+            pos++;
+            skipSpaces();
+            if (text[pos] == '}') {
+                pos++;
+                return value;
+            }
+            do {
+                std::string key = parseString();
+                expect(':');
+                value.object[key] = parseValue();
+                skipSpaces();
+            } while (pos < text.size() && text[pos] == ',' && ++pos);
+            expect('}');
+        } else if (c == '[') {
+            value.type = Json::Type::Array;
+            pos++;
+            skipSpaces();
+            if (text[pos] == ']') {
+                pos++;
+                return value;
+            }
+            do {
+                value.array.push_back(parseValue());
+                skipSpaces();
+            } while (pos < text.size() && text[pos] == ',' && ++pos);
+            expect(']');
+        } else if (c == '"') {
+            value.type = Json::Type::String;
+            value.string = parseString();
+        } else if (consume("true")) {
+            value.type = Json::Type::Bool;
+            value.boolean = true;
+        } else if (consume("false")) {
+            value.type = Json::Type::Bool;
+        } else if (consume("null")) {
+            value.type = Json::Type::Null;
+        } else {
+            const char* start = text.c_str() + pos;
+            char* end = nullptr;
+            value.type = Json::Type::Number;
+            value.number = std::strtod(start, &end);
+            if (end == start)
+                fail("invalid value");
+            pos += end - start;
+        }
+        return value;
+    }
+};
+
+inline Json readJsonFile(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("Cannot open " + path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+    return JsonParser(text).parse();
+}
+
+} // namespace bench
+
+#endif // JSON_READER_HPP
@@ -0,0 +1,50 @@
+// Hardware performance counters (cycles, instructions, cache misses, FP instructions) of
+// every `Matrix` operation, e.g. to tell whether `Matrix::operator*` is memory- or FMA-bound.
+// The library must be built with `-DMATRIX_INSTRUMENT` (see the `perf_matrix` Makefile target).
+//
+//     OMP_NUM_THREADS=4 ./perf_matrix --sizes 256,1024
+
+#include "bench_utils.hpp"
+#include "matrix.hpp"
+#include "perf_counters.hpp"
+
+int main(int argc, char** argv)
+{
+    bench::Options options;
+    try {
+        options = bench::parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    for (int n : options.sizes) {
+        Matrix a(n, n), b(n, n);
+        a.fill(1.0);
+        b.fill(2.0);
+
+        // The counters are attached to the threads of the OpenMP pool that exist when
+        // they are opened, which are reused by the following parallel regions.
+        PerfCounters counters;
+        if (!counters.available()) {
+            counters.report(std::cerr);
+            return 1;
+        }
+
+        instrumentation::addListener(&counters);
+        Matrix c = a + b;
+        c = a - b;
+        c = a * 2.0;
+        c.sub_mul(0.5, a);
+        c = a.transpose();
+        c = a.apply([](double x) { return x * x; });
+        c = a * b;
+        c.fill(0.0);
+        instrumentation::removeListener(&counters);
+
+        std::cout << "n = " << n << std::endl;
+        counters.report(std::cout);
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Communication profile of the `DistributedMatrix` operations (Part 3, question 1): for each
+// operation, the time blocked in MPI against the computation, the bytes and messages of every
+// process and the load imbalance between the processes. The library must be built with
+// `-DMATRIX_INSTRUMENT` (see the `profile_distributed` Makefile target).
+//
+//     mpirun -np 4 ./profile_distributed --sizes 256,1024
+
+#include "bench_utils.hpp"
+#include "comm_profiler.hpp"
+#include "distributed_matrix.hpp"
+#include "matrix.hpp"
+#include <mpi.h>
+
+int main(int argc, char** argv)
+{
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    bench::Options options;
+    try {
+        options = bench::parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        if (rank == 0)
+            std::cerr << e.what() << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    for (int n : options.sizes) {
+        Matrix fullA(n, n), fullB(n, n);
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++) {
+                fullA.set(i, j, (i + 2.0 * j) / n);
+                fullB.set(i, j, (2.0 * i - j) / n);
+            }
+        DistributedMatrix a(fullA, numProcs);
+        DistributedMatrix b(fullB, numProcs);
+        DistributedMatrix blockA(fullA, numProcs, DistributedMatrix::Layout::BlockCyclic);
+        DistributedMatrix blockB(fullB, numProcs, DistributedMatrix::Layout::BlockCyclic);
+
+        CommProfiler profiler;
+        instrumentation::addListener(&profiler);
+        for (int repeat = 0; repeat < 3; repeat++) {
+            DistributedMatrix c = a + b;
+            c.sub_mul(1e-3, a);
+            volatile double sum = c.sum();
+            (void)sum;
+            Matrix full = a.gather();
+            full = a.transpose();
+            c = multiply(fullA, b);
+            full = a.multiplyTransposed(b);
+            c = a.multiplyTransposedDistributed(b);
+            DistributedMatrix blockC = blockA * blockB;
+            sync_matrix(&full, rank, 0);
+        }
+        instrumentation::removeListener(&profiler);
+
+        if (rank == 0)
+            std::cout << "n = " << n << std::endl;
+        profiler.report(std::cout);
+        if (rank == 0)
+            std::cout << std::endl;
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,30 @@
+// Autotunes the block sizes, micro-kernel and number of threads of `Matrix::operator*`
+// on this host and persists the result, so that later runs load it at startup.
+//
+//     ./tune_gemm [size]      # default size: 512
+//
+// Run it once per host (and instruction set, see MATRIX_ISA) with the number of OpenMP
+// threads the applications will use.
+
+#include "matrix.hpp"
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    const int size = argc > 1 ? std::atoi(argv[1]) : 512;
+    try {
+        const Matrix::GemmTuning before = Matrix::gemmTuning();
+        std::cout << "Tuning the " << Matrix::kernelISA() << " GEMM on " << size << " x " << size
+                  << " matrices (current: mc=" << before.mc << " kc=" << before.kc << " nc=" << before.nc
+                  << " kernel=" << before.microKernel << " threads=" << before.threads << ")" << std::endl;
+        const Matrix::GemmTuning tuning = Matrix::autotuneGemm(size);
+        std::cout << "Best: mc=" << tuning.mc << " kc=" << tuning.kc << " nc=" << tuning.nc
+                  << " kernel=" << tuning.microKernel << " threads=" << tuning.threads << std::endl;
+        std::cout << "Saved to " << Matrix::gemmTuningFile() << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
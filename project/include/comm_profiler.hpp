@@ -0,0 +1,72 @@
+#ifndef COMM_PROFILER_HPP
+#define COMM_PROFILER_HPP
+
+// Communication profile of every operation of the distributed library: per instrumentation
+// zone, the time, the part of it blocked in MPI calls (the rest being computation), the bytes
+// sent and received and the number of messages, then aggregated over the processes to show
+// the load imbalance. Build the library with `-DMATRIX_INSTRUMENT` so that its operations
+// are zones and its MPI calls are reported (see `profiled_mpi.hpp`):
+//
+//     CommProfiler profiler;
+//     instrumentation::addListener(&profiler);
+//     Matrix c = a.multiplyTransposed(b);
+//     instrumentation::removeListener(&profiler);
+//     profiler.report(std::cout);            // Collective
+//
+// or `CommProfiler::profileUntilFinalize(std::cerr)` to profile the whole run and print
+// the table in MPI_Finalize.
+
+#include "instrumentation.hpp"
+#include <map>
+#include <mpi.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class CommProfiler : public instrumentation::ZoneListener
+{
+public:
+    // Per-zone totals of this process, inclusive of the nested zones
+    struct ZoneStats {
+        long calls = 0;
+        double seconds = 0.0;
+        double mpiSeconds = 0.0; // Inside MPI calls
+        double bytesSent = 0.0;
+        double bytesReceived = 0.0;
+        long messages = 0;
+
+        double computeSeconds() const { return seconds - mpiSeconds; }
+    };
+
+    CommProfiler() = default;
+    CommProfiler(const CommProfiler &) = delete;
+    CommProfiler &operator=(const CommProfiler &) = delete;
+
+    void enterZone(const char *name) override;
+    void exitZone(const char *name) override;
+    void communication(const char *call, double seconds, double bytesSent, double bytesReceived, int messages) override;
+
+    const std::map<std::string, ZoneStats> &zones() const;
+    // Per MPI call, outside of any zone included
+    const std::map<std::string, ZoneStats> &calls() const;
+
+    // Table of the zones over the processes of `comm` (collective, written by its rank 0):
+    // calls, maximum and mean time, imbalance (maximum over mean), mean MPI time, communication
+    // fraction (MPI time over time), and mean bytes and messages per process
+    void report(std::ostream &out, MPI_Comm comm = MPI_COMM_WORLD) const;
+
+    // Registers a profiler that writes its report to `out` (on rank 0) in MPI_Finalize
+    static void profileUntilFinalize(std::ostream &out);
+
+private:
+    struct OpenZone {
+        std::string name;
+        double start;
+    };
+
+    std::vector<OpenZone> stack_;
+    std::map<std::string, ZoneStats> zones_;
+    std::map<std::string, ZoneStats> calls_;
+};
+
+#endif // COMM_PROFILER_HPP
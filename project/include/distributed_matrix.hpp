@@ -1,33 +1,243 @@
 #ifndef DISTRIBUTED_MATRIX_H
 #define DISTRIBUTED_MATRIX_H
 
+#include "instrumentation.hpp"
 #include "matrix.hpp"
 #include <mpi.h>
 #include <vector>
 #include <functional>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+// Pr x Pc grid of MPI processes with Cartesian sub-communicators for its rows and columns.
+// Process `rank` is at grid row `rank / cols` and grid column `rank % cols`.
+struct ProcessGrid
+{
+    int rows;         // Pr
+    int cols;         // Pc
+    int myRow;        // Grid row of this process
+    int myCol;        // Grid column of this process
+    MPI_Comm comm;    // All the processes of the grid (same ranks as the communicator of the matrix)
+    MPI_Comm rowComm; // Processes of the same grid row, ranked by grid column
+    MPI_Comm colComm; // Processes of the same grid column, ranked by grid row
+};
+
+// Split of the `n` indices of one dimension of a matrix across `procs` processes
+struct IndexDistribution
+{
+    int n = 0;     // Number of indices
+    int procs = 1; // Number of processes along this dimension
+    int block = 0; // 0: contiguous parts as equal as possible (the first `n % procs` processes
+                   // get one more index), else blocks of `block` indices dealt round-robin
+    std::vector<int> offsets; // If not empty (with block 0): process p owns the contiguous
+                              // indices [offsets[p], offsets[p + 1]), see Partitioner
+
+    int localSize(int p) const;           // Number of indices owned by process p
+    int owner(int global) const;          // Process owning a global index
+    int toLocal(int global) const;        // Local index of a global index in its owner
+    int toGlobal(int p, int local) const; // Global index of a local index of process p
+
+    bool operator==(const IndexDistribution& other) const;
+};
+
+class DistributedMatrix;
+
+// Read-only matrix replicated once per shared-memory node instead of once per process: it
+// lives in an MPI shared-memory window (MPI_Win_allocate_shared) of the processes of the node
+// (MPI_Comm_split_type with MPI_COMM_TYPE_SHARED), which all read the same copy. Copies share
+// the window; the last one frees it, which is collective over the processes of the node.
+class NodeSharedMatrix
+{
+public:
+    // Broadcast `matrix` from process `src` (ignored elsewhere): the data crosses the network
+    // once per node, between one process of every node, then is read in place. Collective
+    // over `comm`, in which `src` is a rank.
+    NodeSharedMatrix(const Matrix& matrix, int src, MPI_Comm comm = MPI_COMM_WORLD);
+
+    int numRows() const;
+    int numCols() const;
+    double get(int i, int j) const;
+    // Row-major elements, shared by the processes of the node
+    const double* rawData() const;
+    // Private copy
+    Matrix toMatrix() const;
+
+private:
+    struct Window;
+    friend class DistributedMatrix;
+    NodeSharedMatrix(int rows, int cols, MPI_Comm comm); // Zeros, collective over `comm`
+
+    int rows = 0;
+    int cols = 0;
+    std::shared_ptr<Window> window;
+};
+
+// Strategy choosing how many consecutive columns each process owns with Layout::Columns.
+// All the processes must use partitioners giving the same split.
+class Partitioner
+{
+public:
+    virtual ~Partitioner() = default;
+    // Number of indices of each of the `procs` processes, `n` in total
+    virtual std::vector<int> partition(int n, int procs) const = 0;
+};
+
+// Parts as equal as possible (the default split)
+class EqualPartitioner : public Partitioner
+{
+public:
+    std::vector<int> partition(int n, int procs) const override;
+};
+
+// Parts proportional to the speed of the processes, e.g. for nodes of different generations
+class WeightedPartitioner : public Partitioner
+{
+public:
+    // One positive speed per process (any unit)
+    //      Throws std::invalid_argument if a speed is not positive
+    explicit WeightedPartitioner(std::vector<double> speeds);
+    // Speeds measured on `matrix`: each process timed its share of an iteration (`seconds`)
+    // and its speed is its number of local columns per second. Collective.
+    static WeightedPartitioner measured(const DistributedMatrix& matrix, double seconds);
+
+    std::vector<int> partition(int n, int procs) const override;
+    const std::vector<double>& getSpeeds() const;
+
+private:
+    std::vector<double> speeds;
+};
+
+// Parts of equal total cost, given the (measured or estimated) cost of every column, e.g. its
+// number of nonzeros or the time spent on it; the costs of a process are divided by its speed
+// if speeds are given
+class CostPartitioner : public Partitioner
+{
+public:
+    //      Throws std::invalid_argument if a cost is negative or a speed is not positive
+    explicit CostPartitioner(std::vector<double> costs, std::vector<double> speeds = {});
+
+    std::vector<int> partition(int n, int procs) const override;
+
+private:
+    std::vector<double> costs;
+    std::vector<double> speeds;
+};
+
+// Lossy compression of the data of collectives, for networks whose bandwidth is the bottleneck:
+//  - Kind::Float16 and Kind::BFloat16: the elements travel as 16-bit floats, a quarter of the
+//    bytes, and reductions sum them with a custom MPI operator. Float16 (IEEE half precision)
+//    keeps 11 significant bits but overflows beyond 65504; BFloat16 keeps the range of a float
+//    with 8 significant bits.
+//  - Kind::TopK: a reduction sends only the `fraction` of the elements of largest magnitude of
+//    every process (with their indices), gathered by every process and summed there.
+// With error feedback, what a process could not send in a reduction (rounding errors, or the
+// elements left out) is kept and added to its contribution to the next reduction of the same
+// size with this object, so that small gradients are delayed rather than lost.
+class CollectiveCompression
+{
+public:
+    enum class Kind { None, Float16, BFloat16, TopK };
+
+    //      Throws std::invalid_argument if the fraction of a top-k is not in (0, 1]
+    explicit CollectiveCompression(Kind kind, double fraction = 0.01, bool errorFeedback = true);
+
+    Kind getKind() const;
+    double getFraction() const;
+
+    // In-place sum of `count` elements over the processes of `comm`
+    void allreduce(double* data, long count, MPI_Comm comm);
+    // In-place broadcast of `count` elements from `root` of `comm`; the root also keeps the
+    // values that the others receive, so that all hold the same ones. There are no previous
+    // values to add the sparse elements of a top-k to: Kind::TopK throws std::invalid_argument.
+    void broadcast(double* data, long count, int root, MPI_Comm comm);
+
+private:
+    Kind kind;
+    double fraction;
+    bool errorFeedback;
+    std::vector<double> residual; // Error feedback of the last reduction
+};
 
 // Represent a *global* matrix of size `globalRows x globalCols` by
-// storing a *local* matrix on each process that represents the part of the matrix
-// from column `startCol` (included, 0-based index) to column `startCol + localCols` (excluded, 0-based index).
+// storing a *local* matrix on each process of a `Pr x Pc` process grid.
+//  - Layout::Columns (default): a 1 x P grid, each process stores all the rows of a contiguous
+//    range of `localCols` columns, the ranges being as equal as possible.
+//  - Layout::BlockCyclic: a grid as square as possible chosen from `numProcesses`, rows and
+//    columns are dealt in blocks of `blockSize` round-robin over the grid rows and columns
+//    (as in ScaLAPACK), so the memory per process shrinks as 1/P for both dimensions.
+//  - Layout::Rows: a P x 1 grid, each process stores all the columns of a contiguous range of
+//    rows, for tall and skinny matrices (see tsqr).
+//  - Layout::Auto: Layout::BlockCyclic when the number of processes is not prime and every
+//    grid row and column gets at least one block, else Layout::Columns. getLayout() returns
+//    the layout chosen.
 class DistributedMatrix
 {
+public:
+    enum class Layout { Columns, BlockCyclic, Rows, Auto };
+
 private:
     int globalRows;    // Total number of rows
     int globalCols;    // Total number of columns
+    int localRows;     // Number of rows in this process
     int localCols;     // Number of columns in this process
-    int startCol;      // Starting column index for this process
     int numProcesses;  // Total number of MPI processes
     int rank;          // Rank of this process
+    Layout layout;
+    IndexDistribution rowDist; // Split of the rows over the grid rows
+    IndexDistribution colDist; // Split of the columns over the grid columns
+    std::shared_ptr<const ProcessGrid> grid;
     Matrix localData;  // Local portion of the matrix
+    struct RemoteAccess;
+    std::shared_ptr<RemoteAccess> remote; // RMA window over localData, during remote access
+
+    // Matrix of size `rows x cols` filled with zeros, distributed like `like` on the same grid
+    DistributedMatrix(int rows, int cols, const DistributedMatrix& like);
+    // Matrix distributed like `like` whose local block is `local` (taken over, not copied)
+    DistributedMatrix(const DistributedMatrix& like, Matrix&& local);
+
+    // Throws std::invalid_argument unless `other` has the dimensions and the partitioning of
+    // this matrix (for the element-wise operation `op`)
+    void requireSamePartitioning(const DistributedMatrix& other, const char* op) const;
+
+    // Sets up the grid, the distributions and a zero local block once the dimensions are known
+    void distribute(int blockSize, MPI_Comm comm);
+
+    // Owner (rank in the grid) of element (i, j) and its offset in the local block of the owner
+    //      Throws std::out_of_range if the element is outside the matrix
+    std::pair<int, MPI_Aint> remoteLocation(int i, int j) const;
+
+    // left * right for a row-major left matrix (leftRows x leftCols) on every process
+    static DistributedMatrix multiplyLeft(const double* left, int leftRows, int leftCols, const DistributedMatrix& right);
 
 public:
     // --- Constructors & Assignment ---
-    //      Assumes that MPI is already initialized
-    //      This constructor is called in parallel by all processes
+    //      Assumes that MPI is already initialized (with MPI_THREAD_FUNNELED when built with
+    //      OpenMP: the local Matrix operations run on OpenMP threads, MPI is only called by the
+    //      thread calling DistributedMatrix)
+    //      This constructor is called in parallel by all processes of `comm` (numProcesses of
+    //      them): independent groups of processes can hold their own matrices, whose collectives
+    //      stay within the group. A communicator other than MPI_COMM_WORLD must outlive its
+    //      matrices.
     //      Extract the columns that should be handled by this process in localData
     DistributedMatrix(const Matrix& matrix, int numProcesses);
+    DistributedMatrix(const Matrix& matrix, int numProcesses, Layout layout, int blockSize = 64,
+                      MPI_Comm comm = MPI_COMM_WORLD);
+    // Layout::Columns with the split of the columns chosen by `partitioner`
+    DistributedMatrix(const Matrix& matrix, int numProcesses, const Partitioner& partitioner,
+                      MPI_Comm comm = MPI_COMM_WORLD);
+    // Read from a binary file written by writeCollective, each process reading its own elements
+    // with collective MPI-IO: the full matrix never needs to fit in the memory of one process.
+    //      Throws std::runtime_error if the file cannot be read or is not a matrix file
+    DistributedMatrix(const std::string& path, int numProcesses, Layout layout = Layout::Columns, int blockSize = 64,
+                      MPI_Comm comm = MPI_COMM_WORLD);
     DistributedMatrix(const DistributedMatrix& other);
-    DistributedMatrix& operator=(const DistributedMatrix& other) = default;
+    // Takes over the local block of `other`, which is left empty
+    //      Throws std::logic_error during the remote access of `other`
+    DistributedMatrix(DistributedMatrix&& other);
+    DistributedMatrix& operator=(const DistributedMatrix& other);
 
     // --- Common API (shared with Matrix and MatrixCL) ---
 
@@ -40,6 +250,11 @@ public:
     DistributedMatrix operator-(const DistributedMatrix& other) const;
     DistributedMatrix operator*(double scalar) const;
 
+    // DistributedMatrix * DistributedMatrix multiplication (SUMMA): neither operand is replicated.
+    //      Both operands must live on the same process grid; the result has the row
+    //      distribution of this matrix and the column distribution of `other`.
+    DistributedMatrix operator*(const DistributedMatrix& other) const;
+
     // Note: returns a regular Matrix (requires gathering all data)
     Matrix transpose() const;
 
@@ -48,31 +263,115 @@ public:
 
     // --- Distributed-specific operations ---
 
+    // Element (i, j): owned by this process, or any element during remote access
     double get(int i, int j) const;
     void set(int i, int j, double value);
 
-    // Column index conversions
+    // --- One-sided access to remote elements (MPI RMA, passive target) ---
+    //      Between beginRemoteAccess() and endRemoteAccess(), both collective, every process
+    //      reads and updates any element without the participation of its owner: the local
+    //      blocks are exposed in an MPI window, in a single MPI_Win_lock_all epoch. Meanwhile the
+    //      matrix must not be assigned nor repartitioned (std::logic_error).
+    //      Remote get() and getMany() (MPI_Get) return the current value; remote set()
+    //      (MPI_Accumulate with MPI_REPLACE), accumulate() and accumulateMany() (MPI_Accumulate
+    //      with MPI_SUM, atomic per element) complete at the next flush() of the calling process.
+    //      Local elements are accessed directly: a process sees the updates of the others once
+    //      they have flushed and it has called flush() itself. Updates by several processes to
+    //      the same element must use accumulate.
+    void beginRemoteAccess();
+    void endRemoteAccess();
+    bool inRemoteAccess() const;
+
+    // element(i, j) += value
+    void accumulate(int i, int j, double value);
+    // Batched access: one request per owner process for all the elements it owns (an indexed
+    // datatype), instead of one per element
+    std::vector<double> getMany(const std::vector<std::pair<int, int>>& elements) const;
+    void accumulateMany(const std::vector<std::pair<int, int>>& elements, const std::vector<double>& values);
+    // Completes the pending updates of this process and makes those completed by the others visible
+    void flush();
+
+    // Column index conversions (-1 if out of range or not owned by this process)
     int globalColIndex(int localColIndex) const;
     int localColIndex(int globalColIndex) const;
+    // Process of this grid row that owns a column (with Layout::Columns, the owner of the whole column)
     int ownerProcess(int globalColIndex) const;
 
+    // Row index conversions (identity with Layout::Columns)
+    int globalRowIndex(int localRowIndex) const;
+    int localRowIndex(int globalRowIndex) const;
+    // Process owning element (i, j)
+    int ownerProcess(int globalRowIndex, int globalColIndex) const;
+
+    Layout getLayout() const;
+    const ProcessGrid& getGrid() const;
+    const IndexDistribution& getRowDistribution() const;
+    const IndexDistribution& getColDistribution() const;
+
     const Matrix& getLocalData() const;
 
+    // Move the columns to the split chosen by `partitioner` (Layout::Columns only), each
+    // process sending to every other the columns that change owner (MPI_Alltoallw). Matrices
+    // used together must be repartitioned alike. Collective.
+    //      Throws std::invalid_argument with another layout or an invalid partition
+    void repartition(const Partitioner& partitioner);
+
     // Apply a function element-wise (no communication needed)
     DistributedMatrix apply(const std::function<double(double)> &func) const;
 
-    // Apply a binary function to two distributed matrices with the same column partitioning
+    // Apply a binary function to two distributed matrices with the same partitioning
     static DistributedMatrix applyBinary(
         const DistributedMatrix& a,
         const DistributedMatrix& b,
         const std::function<double(double, double)> &func);
 
+    // --- In-place and fused element-wise operations ---
+    //      A single pass over the local block, without temporary matrices nor communication.
+    //      `func` is any callable, inlined (unlike the std::function of apply), so that the loop
+    //      vectorizes: W.axpby(-lr, grad, 1.0, f) computes W.sub_mul(lr, grad.apply(f)) with one
+    //      read of W and grad and one write of W, instead of three passes and two copies.
+    //      The operands must have the same partitioning (std::invalid_argument).
+
+    // this = func(this)
+    template <typename F>
+    void applyInPlace(F func);
+    // this = func(this, other)
+    template <typename F>
+    void applyBinaryInPlace(const DistributedMatrix& other, F func);
+    // this = alpha * x + beta * this
+    void axpby(double alpha, const DistributedMatrix& x, double beta);
+    // this = alpha * func(x) + beta * this
+    template <typename F>
+    void axpby(double alpha, const DistributedMatrix& x, double beta, F func);
+
     // Matrix * DistributedMatrix multiplication
     friend DistributedMatrix multiply(const Matrix& left, const DistributedMatrix& right);
+    friend DistributedMatrix multiply(const NodeSharedMatrix& left, const DistributedMatrix& right);
 
     // DistributedMatrix * DistributedMatrix^T (returns a regular Matrix)
-    //      Assumes the same column partitioning for both inputs
+    //      Assumes the same column partitioning (and grid) for both inputs
     Matrix multiplyTransposed(const DistributedMatrix& other) const;
+    // The same with a compressed reduction (see CollectiveCompression), for instance to
+    // exchange gradients: the error feedback is kept in `compression` from one call to the next
+    Matrix multiplyTransposed(const DistributedMatrix& other, CollectiveCompression& compression) const;
+
+    // DistributedMatrix * DistributedMatrix^T, distributed like this matrix (MPI_Reduce_scatter):
+    //      half the communication volume of multiplyTransposed and 1/P of its memory per process
+    DistributedMatrix multiplyTransposedDistributed(const DistributedMatrix& other) const;
+
+    // DistributedMatrix * DistributedMatrix^T replicated once per node: the partial products of
+    // the processes of a node are summed in shared memory, then across the nodes by one
+    // process per node. Same conditions as multiplyTransposed.
+    NodeSharedMatrix multiplyTransposedShared(const DistributedMatrix& other) const;
+
+    // Thin QR factorization of a tall and skinny matrix (TSQR): returns Q, distributed like this
+    // matrix with orthonormal columns, and R, upper triangular with a non-negative diagonal
+    // (numCols() x numCols(), on every process), such that this = Q * R. Each process factors its
+    // rows (Householder), then the R factors are combined pairwise along a binary tree, and Q is
+    // rebuilt down the same tree: O(log P) messages of numCols()^2 elements, instead of one
+    // allreduce per column for Gram-Schmidt.
+    //      Requires whole rows on every process (Layout::Rows or a single process)
+    std::pair<DistributedMatrix, Matrix> tsqr() const;
 
     // Sum of all elements across all processes
     double sum() const;
@@ -80,13 +379,202 @@ public:
     // Gather into a complete matrix on all processes (for testing/debugging)
     Matrix gather() const;
 
+    // Gather into a complete matrix on process `root` only; the other processes get a 0 x 0 matrix
+    Matrix gatherTo(int root) const;
+
+    // Write the matrix to a binary file with collective MPI-IO, each process writing its own
+    // elements: no process ever holds more than its local block. The file holds the number of
+    // rows and of columns (two 64-bit integers) followed by the elements in row-major order,
+    // all in the native byte order. Throws std::runtime_error if the file cannot be written.
+    void writeCollective(const std::string& path) const;
+
     ~DistributedMatrix() = default;
 };
 
+// --- Element-wise templates of DistributedMatrix ---
+//      Threaded like the Matrix kernels from 2^15 elements per process
+
+template <typename F>
+void DistributedMatrix::applyInPlace(F func)
+{
+    MATRIX_ZONE("DistributedMatrix::applyInPlace");
+    double* x = localData.rawData();
+    const long n = static_cast<long>(localRows) * localCols;
+#pragma omp parallel for simd schedule(static) if (n >= (1L << 15))
+    for (long k = 0; k < n; k++)
+        x[k] = func(x[k]);
+}
+
+template <typename F>
+void DistributedMatrix::applyBinaryInPlace(const DistributedMatrix& other, F func)
+{
+    MATRIX_ZONE("DistributedMatrix::applyBinaryInPlace");
+    requireSamePartitioning(other, "applyBinaryInPlace");
+    double* x = localData.rawData();
+    const double* y = other.localData.rawData();
+    const long n = static_cast<long>(localRows) * localCols;
+#pragma omp parallel for simd schedule(static) if (n >= (1L << 15))
+    for (long k = 0; k < n; k++)
+        x[k] = func(x[k], y[k]);
+}
+
+template <typename F>
+void DistributedMatrix::axpby(double alpha, const DistributedMatrix& x, double beta, F func)
+{
+    MATRIX_ZONE("DistributedMatrix::axpby");
+    requireSamePartitioning(x, "axpby");
+    double* y = localData.rawData();
+    const double* a = x.localData.rawData();
+    const long n = static_cast<long>(localRows) * localCols;
+#pragma omp parallel for simd schedule(static) if (n >= (1L << 15))
+    for (long k = 0; k < n; k++)
+        y[k] = alpha * func(a[k]) + beta * y[k];
+}
+
 // Matrix * DistributedMatrix multiplication (left matrix already on all processes)
 DistributedMatrix multiply(const Matrix& left, const DistributedMatrix& right);
+// Same with the left matrix replicated once per node
+DistributedMatrix multiply(const NodeSharedMatrix& left, const DistributedMatrix& right);
 
 // Broadcast a matrix from one process to all others
-void sync_matrix(Matrix *matrix, int rank, int src);
+//      Large matrices go through a MatrixBroadcast with the default segment size
+//      `rank` and `src` are ranks in `comm`
+void sync_matrix(Matrix *matrix, int rank, int src, MPI_Comm comm = MPI_COMM_WORLD);
+// The same with the elements compressed to 16-bit floats (see CollectiveCompression)
+void sync_matrix(Matrix *matrix, int rank, int src, CollectiveCompression& compression, MPI_Comm comm = MPI_COMM_WORLD);
+
+// Pipelined broadcast of a matrix from process `src`, in segments of whole rows: each segment
+// is a separate MPI_Ibcast, all started at construction, so that the segments move through
+// the broadcast tree one behind the other (instead of the whole matrix at each stage) and the
+// caller can work on the rows already received while the others arrive:
+//
+//     MatrixBroadcast bcast(&matrix, rank, src);
+//     for (int s = 0; s < bcast.numSegments(); s++) {
+//         bcast.waitSegment(s);
+//         ... use rows [bcast.segmentBegin(s), bcast.segmentEnd(s)) of the matrix ...
+//     }
+//
+// The dimensions are broadcast first (blocking) and the matrix of the other processes is
+// resized. The matrix must not be used otherwise until the broadcast completes; the destructor
+// waits for it. Collective over `comm`.
+class MatrixBroadcast
+{
+public:
+    // `segmentBytes` (0: $MATRIX_BCAST_SEGMENT bytes, else 1 MiB) is rounded to whole rows
+    MatrixBroadcast(Matrix* matrix, int rank, int src, long segmentBytes = 0, MPI_Comm comm = MPI_COMM_WORLD);
+    ~MatrixBroadcast();
+    MatrixBroadcast(const MatrixBroadcast&) = delete;
+    MatrixBroadcast& operator=(const MatrixBroadcast&) = delete;
+
+    int numSegments() const;
+    int segmentBegin(int segment) const; // First row of a segment
+    int segmentEnd(int segment) const;   // Row after the last row of a segment
+
+    // Whether a segment has arrived (without blocking)
+    bool testSegment(int segment);
+    // Blocks until a segment has arrived
+    void waitSegment(int segment);
+    // Blocks until the whole matrix has arrived
+    void wait();
+
+private:
+    Matrix* matrix;
+    int segmentRows;
+    std::vector<MPI_Request> requests;
+};
+
+// Asynchronous checkpoint of a DistributedMatrix, for long jobs that must survive the loss of a
+// process. The constructor copies the local block, which is the only stall of the computation.
+// A background thread of every process then writes its elements with POSIX I/O to
+// `path + ".partial"`, in the format of writeCollective, while the computation goes on. The
+// thread makes no MPI call, so MPI_THREAD_FUNNELED is enough. commit() checks that every process
+// succeeded and renames the file to `path` atomically: a job killed before the commit still has
+// its previous checkpoint. To restart, with the same or another number of processes or layout,
+// use the file constructor DistributedMatrix(path, numProcesses, layout). The file system must be
+// shared by the processes.
+class AsyncCheckpoint
+{
+public:
+    // Collective over the processes of the matrix
+    AsyncCheckpoint(const DistributedMatrix& matrix, const std::string& path);
+    // Waits for the writer thread, without committing
+    ~AsyncCheckpoint();
+    AsyncCheckpoint(const AsyncCheckpoint&) = delete;
+    AsyncCheckpoint& operator=(const AsyncCheckpoint&) = delete;
+
+    // Whether this process has written all its elements (without blocking)
+    bool written() const;
+    // Waits for every process to write its elements, then publishes the checkpoint. Collective.
+    //      Throws std::runtime_error (on all processes) if a process could not write the file
+    void commit();
+
+private:
+    // Elements of the snapshot stored consecutively in the file
+    struct Segment
+    {
+        size_t first;
+        long fileOffset;
+        size_t count;
+    };
+
+    void write(bool header, long rows, long cols);
+
+    std::string path;
+    MPI_Comm comm;
+    std::vector<double> snapshot;
+    std::vector<Segment> segments;
+    std::thread writer;
+    std::atomic<bool> finished{false};
+    std::string error; // Set by the writer thread
+};
+
+// Data-parallel synchronization of gradients: every process holds all the parameters and a
+// shard of the samples, computes the gradients of the loss on its shard, and the gradients are
+// averaged over the processes. They are grouped into buckets of about `bucketBytes` (0:
+// $MATRIX_GRADIENT_BUCKET bytes, else 1 MiB) in the order in which they become ready, i.e. the
+// order in which backpropagation produces them (last layer first), and the allreduce of a bucket
+// (MPI_Iallreduce) starts as soon as its last gradient is ready, while the backpropagation of the
+// earlier layers goes on. Reusable from one step to the next. Collective over `comm`, e.g. the
+// processes of one replica of a model-parallel group.
+class GradientSynchronizer
+{
+public:
+    GradientSynchronizer(const std::vector<Matrix*>& gradients, long bucketBytes = 0, MPI_Comm comm = MPI_COMM_WORLD);
+    ~GradientSynchronizer();
+    GradientSynchronizer(const GradientSynchronizer&) = delete;
+    GradientSynchronizer& operator=(const GradientSynchronizer&) = delete;
+
+    int numBuckets() const;
+
+    // Gradient `index` is final for this step (once per step, on every process)
+    void ready(int index);
+    // Blocks until every gradient, all of which must be ready, holds its average over the processes
+    void wait();
+
+private:
+    struct Bucket
+    {
+        std::vector<int> gradients;
+        std::vector<double> buffer; // Empty for a bucket of a single gradient, reduced in place
+        int pending = 0;
+        MPI_Request request = MPI_REQUEST_NULL;
+    };
+
+    MPI_Comm comm;
+    std::vector<Matrix*> gradients;
+    std::vector<Bucket> buckets;
+    std::vector<int> bucketOf;    // Bucket of each gradient
+    std::vector<long> offsetOf;   // Offset of each gradient in the buffer of its bucket
+    std::vector<bool> isReady;
+};
+
+// Data-parallel gradient descent: `steps` times, `backward` computes into `gradients` the
+// gradients of the loss on the samples of this process, calling `sync.ready(i)` as soon as
+// gradient i is final, then every parameter i takes the step -learningRate * (average of
+// gradient i). The parameters stay identical on all processes if they start so.
+void dataParallelGradientDescent(const std::vector<Matrix*>& parameters, const std::vector<Matrix*>& gradients,
+                                 double learningRate, int steps,
+                                 const std::function<void(GradientSynchronizer& sync)>& backward, long bucketBytes = 0,
+                                 MPI_Comm comm = MPI_COMM_WORLD);
 
 #endif // DISTRIBUTED_MATRIX_H
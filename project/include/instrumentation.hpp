@@ -0,0 +1,91 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+// Instrumentation zones: every operation of the matrix library is a named zone that
+// profilers (e.g. `PerfCounters`) can attach to by registering a `ZoneListener`.
+// Zones are compiled out unless `MATRIX_INSTRUMENT` is defined, so they cost nothing
+// in regular builds.
+//
+// Zones are entered by the thread calling the library (never inside an OpenMP region),
+// and nested zones (e.g. `DistributedMatrix::operator+` calling `Matrix::operator+`)
+// are reported to the listeners in last-in first-out order.
+//
+// The MPI calls of the distributed library are reported too (see `profiled_mpi.hpp`), with
+// their duration and the bytes that the calling process sends and receives.
+
+#include <algorithm>
+#include <vector>
+
+namespace instrumentation {
+
+class ZoneListener
+{
+public:
+    virtual ~ZoneListener() = default;
+    virtual void enterZone(const char *name) = 0;
+    virtual void exitZone(const char *name) = 0;
+    // An MPI call of the library, inside the zones entered and not exited yet: `messages` is 1
+    // for a call that starts a transfer (a send, a receive or a collective), 0 for one that
+    // waits for it or synchronizes
+    virtual void communication(const char *call, double seconds, double bytesSent, double bytesReceived, int messages)
+    {
+        (void)call, (void)seconds, (void)bytesSent, (void)bytesReceived, (void)messages;
+    }
+};
+
+inline std::vector<ZoneListener *> &listeners()
+{
+    static std::vector<ZoneListener *> registered;
+    return registered;
+}
+
+inline void addListener(ZoneListener *listener)
+{
+    listeners().push_back(listener);
+}
+
+inline void removeListener(ZoneListener *listener)
+{
+    auto &registered = listeners();
+    registered.erase(std::remove(registered.begin(), registered.end(), listener), registered.end());
+}
+
+inline void communication(const char *call, double seconds, double bytesSent, double bytesReceived, int messages)
+{
+    for (ZoneListener *listener : listeners())
+        listener->communication(call, seconds, bytesSent, bytesReceived, messages);
+}
+
+// Notifies the listeners when entering and leaving the scope in which it lives
+class Zone
+{
+public:
+    explicit Zone(const char *name) : name(name)
+    {
+        for (ZoneListener *listener : listeners())
+            listener->enterZone(name);
+    }
+    ~Zone()
+    {
+        auto &registered = listeners();
+        for (auto it = registered.rbegin(); it != registered.rend(); ++it)
+            (*it)->exitZone(name);
+    }
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+
+private:
+    const char *name;
+};
+
+} // namespace instrumentation
+
+#ifdef MATRIX_INSTRUMENT
+#define MATRIX_ZONE_CONCAT_(a, b) a##b
+#define MATRIX_ZONE_CONCAT(a, b) MATRIX_ZONE_CONCAT_(a, b)
+#define MATRIX_ZONE(name) instrumentation::Zone MATRIX_ZONE_CONCAT(matrixZone_, __LINE__)(name)
+#else
+#define MATRIX_ZONE(name) ((void)0)
+#endif
+
+#endif // INSTRUMENTATION_HPP
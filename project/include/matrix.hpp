@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <functional>
+#include <string>
+#include <utility>
 
 class Matrix
 {
@@ -14,6 +16,7 @@ public:
     // --- Constructors & Assignment ---
     Matrix(int rows, int cols);
     Matrix(const Matrix &other);
+    Matrix(Matrix &&other) noexcept; // Leaves `other` empty (0 x 0)
     Matrix &operator=(const Matrix &other)
     {
         if (this != &other)
@@ -24,6 +27,18 @@ public:
         }
         return *this;
     }
+    Matrix &operator=(Matrix &&other) noexcept
+    {
+        if (this != &other)
+        {
+            rows = other.rows;
+            cols = other.cols;
+            data = std::move(other.data);
+            other.rows = other.cols = 0;
+            other.data.clear();
+        }
+        return *this;
+    }
 
     // --- Common API (shared with DistributedMatrix and MatrixCL) ---
 
@@ -47,8 +62,52 @@ public:
     double get(int i, int j) const;
     void set(int i, int j, double value);
 
+    // Row-major element storage (element (i, j) is at index i * numCols() + j),
+    // e.g. to hand the buffer directly to MPI
+    double *rawData();
+    const double *rawData() const;
+
+    // c += a * b for row-major buffers a (m x k), b (k x n) and c (m x n) that are not held by
+    // a Matrix, e.g. MPI shared memory
+    static void multiplyAdd(int m, int n, int k, const double *a, const double *b, double *c);
+
     // Apply a function element-wise
     Matrix apply(const std::function<double(double)> &func) const;
+
+    // Sum of all elements
+    double sum() const;
+
+    // --- Compute kernels ---
+
+    // Instruction set of the kernels in use ("avx512", "avx2", "sse2" or "generic"): the best
+    // one supported by the CPU, unless lowered with the MATRIX_ISA environment variable.
+    static const char *kernelISA();
+    // Switches to the kernels of `isa`; returns false (and changes nothing) if the CPU
+    // does not support it.
+    static bool useKernelISA(const std::string &isa);
+
+    // Parameters of the GEMM: block sizes (rows of A, inner dimension and columns of B kept
+    // in cache), shape of the micro-kernel (index among those of the instruction set) and
+    // number of OpenMP threads (0 for all).
+    struct GemmTuning
+    {
+        int mc = 96;
+        int kc = 256;
+        int nc = 2048;
+        int microKernel = 0;
+        int threads = 0;
+    };
+
+    // Tuning in use: the one persisted for this host (CPU model, cache sizes and instruction
+    // set) in gemmTuningFile(), else derived from the cache sizes. Its number of threads is
+    // capped by omp_get_max_threads() of the process.
+    static GemmTuning gemmTuning();
+    static void setGemmTuning(const GemmTuning &tuning);
+    // Searches the fastest tuning on size x size multiplications, uses it and persists it
+    //      Run it once per host, in a single process (e.g. `make run_tune_gemm`)
+    static GemmTuning autotuneGemm(int size = 512);
+    // $MATRIX_TUNING_FILE, else matrix_gemm_tuning.txt in $XDG_CACHE_HOME or ~/.cache
+    static std::string gemmTuningFile();
 };
 
 #endif // MATRIX_H
@@ -0,0 +1,77 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+// Hardware performance counters per instrumentation zone, read with the Linux
+// `perf_event_open` system call (no daemon or external tool needed).
+//
+// Counters are opened on every OpenMP thread of the process (user space only, which is
+// allowed with the default `perf_event_paranoid` of 2) and summed over the threads.
+// Build the library with `-DMATRIX_INSTRUMENT` so that its operations are zones:
+//
+//     PerfCounters counters;                 // Before any Matrix operation
+//     instrumentation::addListener(&counters);
+//     Matrix c = a * b;
+//     instrumentation::removeListener(&counters);
+//     counters.report(std::cout);
+//
+// Events that the CPU (or the hypervisor) does not expose are skipped; the software
+// events (task clock, page faults) are always reported.
+
+#include "instrumentation.hpp"
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class PerfCounters : public instrumentation::ZoneListener
+{
+public:
+    struct Event {
+        std::string name;
+        uint32_t type;
+        uint64_t config;
+    };
+
+    // Per-zone totals, inclusive of the nested zones
+    struct ZoneStats {
+        long calls = 0;
+        double seconds = 0.0;
+        std::vector<double> counts; // One per event of `events()`
+    };
+
+    // Opens the counters on every thread of the OpenMP thread pool (and on the calling thread).
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Events that could be opened on this machine
+    const std::vector<Event> &events() const;
+    bool available() const;
+
+    // Current value of every event, summed over the threads
+    std::vector<double> read() const;
+
+    void enterZone(const char *name) override;
+    void exitZone(const char *name) override;
+
+    const std::map<std::string, ZoneStats> &zones() const;
+
+    // Table of the zones with cycles, instructions, IPC, cache misses and FP instruction counts
+    void report(std::ostream &out) const;
+
+private:
+    struct OpenZone {
+        std::string name;
+        double start;
+        std::vector<double> counts;
+    };
+
+    std::vector<Event> events_;
+    std::vector<std::vector<int>> fds_; // fds_[thread][event]
+    std::vector<OpenZone> stack_;
+    std::map<std::string, ZoneStats> zones_;
+};
+
+#endif // PERF_COUNTERS_HPP
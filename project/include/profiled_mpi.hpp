@@ -0,0 +1,341 @@
+#ifndef PROFILED_MPI_HPP
+#define PROFILED_MPI_HPP
+
+// Profiling of the MPI calls of the distributed library, without the PMPI interface: with
+// `MATRIX_INSTRUMENT`, a translation unit that includes this header after <mpi.h> has its
+// communication calls replaced (by macros) with wrappers that time them and report them to
+// the instrumentation listeners (see `instrumentation.hpp`), with the bytes that this process
+// sends and receives. Only the calls of the library are seen, so an application keeps its own
+// PMPI tools, and nothing changes without `MATRIX_INSTRUMENT`.
+//
+// Nonblocking operations count their bytes when they start and their waiting time in MPI_Wait
+// and friends; persistent collectives (MPI_Start) only count their time.
+
+#include "instrumentation.hpp"
+#include <mpi.h>
+
+#ifdef MATRIX_INSTRUMENT
+
+namespace profiled_mpi {
+
+inline double bytes(long count, MPI_Datatype type)
+{
+    if (count == 0)
+        return 0.0;
+    int size;
+    MPI_Type_size(type, &size);
+    return static_cast<double>(count) * size;
+}
+
+inline int rankIn(MPI_Comm comm)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    return rank;
+}
+
+inline int sizeOf(MPI_Comm comm)
+{
+    int size;
+    MPI_Comm_size(comm, &size);
+    return size;
+}
+
+// Times the scope of an MPI call and reports it when leaving it
+class Call
+{
+public:
+    Call(const char *name, double sent, double received, int messages)
+        : name(name), sent(sent), received(received), messages(messages), start(MPI_Wtime())
+    {
+    }
+    ~Call() { instrumentation::communication(name, MPI_Wtime() - start, sent, received, messages); }
+    Call(const Call &) = delete;
+    Call &operator=(const Call &) = delete;
+
+private:
+    const char *name;
+    double sent, received;
+    int messages;
+    double start;
+};
+
+// --- Collectives ---
+
+inline int Bcast(void *buffer, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+    const bool isRoot = rankIn(comm) == root;
+    Call call("MPI_Bcast", isRoot ? bytes(count, type) : 0.0, isRoot ? 0.0 : bytes(count, type), 1);
+    return MPI_Bcast(buffer, count, type, root, comm);
+}
+
+inline int Ibcast(void *buffer, int count, MPI_Datatype type, int root, MPI_Comm comm, MPI_Request *request)
+{
+    const bool isRoot = rankIn(comm) == root;
+    Call call("MPI_Ibcast", isRoot ? bytes(count, type) : 0.0, isRoot ? 0.0 : bytes(count, type), 1);
+    return MPI_Ibcast(buffer, count, type, root, comm, request);
+}
+
+inline int Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+    Call call("MPI_Allreduce", bytes(count, type), bytes(count, type), 1);
+    return MPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+}
+
+inline int Iallreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm,
+                      MPI_Request *request)
+{
+    Call call("MPI_Iallreduce", bytes(count, type), bytes(count, type), 1);
+    return MPI_Iallreduce(sendbuf, recvbuf, count, type, op, comm, request);
+}
+
+inline int Reduce_scatter(const void *sendbuf, void *recvbuf, const int recvcounts[], MPI_Datatype type, MPI_Op op,
+                          MPI_Comm comm)
+{
+    const int procs = sizeOf(comm), me = rankIn(comm);
+    long total = 0;
+    for (int p = 0; p < procs; p++)
+        total += recvcounts[p];
+    Call call("MPI_Reduce_scatter", bytes(total - recvcounts[me], type), bytes(recvcounts[me], type) * (procs - 1), 1);
+    return MPI_Reduce_scatter(sendbuf, recvbuf, recvcounts, type, op, comm);
+}
+
+inline int Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                     MPI_Datatype recvtype, MPI_Comm comm)
+{
+    const double received = bytes(recvcount, recvtype);
+    Call call("MPI_Allgather", sendbuf == MPI_IN_PLACE ? received : bytes(sendcount, sendtype),
+              received * (sizeOf(comm) - 1), 1);
+    return MPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+}
+
+inline int Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+                      const int displs[], MPI_Datatype recvtype, MPI_Comm comm)
+{
+    const int procs = sizeOf(comm), me = rankIn(comm);
+    long others = 0;
+    for (int p = 0; p < procs; p++)
+        others += p == me ? 0 : recvcounts[p];
+    Call call("MPI_Allgatherv", sendbuf == MPI_IN_PLACE ? bytes(recvcounts[me], recvtype) : bytes(sendcount, sendtype),
+              bytes(others, recvtype), 1);
+    return MPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+}
+
+inline int Alltoallw(const void *sendbuf, const int sendcounts[], const int sdispls[], const MPI_Datatype sendtypes[],
+                     void *recvbuf, const int recvcounts[], const int rdispls[], const MPI_Datatype recvtypes[],
+                     MPI_Comm comm)
+{
+    const int procs = sizeOf(comm), me = rankIn(comm);
+    double sent = 0.0, received = 0.0;
+    for (int p = 0; p < procs; p++)
+        if (p != me) {
+            sent += bytes(sendcounts[p], sendtypes[p]);
+            received += bytes(recvcounts[p], recvtypes[p]);
+        }
+    Call call("MPI_Alltoallw", sent, received, 1);
+    return MPI_Alltoallw(sendbuf, sendcounts, sdispls, sendtypes, recvbuf, recvcounts, rdispls, recvtypes, comm);
+}
+
+inline int Barrier(MPI_Comm comm)
+{
+    Call call("MPI_Barrier", 0.0, 0.0, 0);
+    return MPI_Barrier(comm);
+}
+
+// --- Point to point ---
+
+inline int Send(const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm)
+{
+    Call call("MPI_Send", bytes(count, type), 0.0, 1);
+    return MPI_Send(buf, count, type, dest, tag, comm);
+}
+
+inline int Recv(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status *status)
+{
+    Call call("MPI_Recv", 0.0, bytes(count, type), 1);
+    return MPI_Recv(buf, count, type, source, tag, comm, status);
+}
+
+inline int Irecv(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Request *request)
+{
+    Call call("MPI_Irecv", 0.0, bytes(count, type), 1);
+    return MPI_Irecv(buf, count, type, source, tag, comm, request);
+}
+
+// --- Completion ---
+
+inline int Wait(MPI_Request *request, MPI_Status *status)
+{
+    Call call("MPI_Wait", 0.0, 0.0, 0);
+    return MPI_Wait(request, status);
+}
+
+inline int Waitall(int count, MPI_Request requests[], MPI_Status statuses[])
+{
+    Call call("MPI_Waitall", 0.0, 0.0, 0);
+    return MPI_Waitall(count, requests, statuses);
+}
+
+inline int Test(MPI_Request *request, int *flag, MPI_Status *status)
+{
+    Call call("MPI_Test", 0.0, 0.0, 0);
+    return MPI_Test(request, flag, status);
+}
+
+inline int Testall(int count, MPI_Request requests[], int *flag, MPI_Status statuses[])
+{
+    Call call("MPI_Testall", 0.0, 0.0, 0);
+    return MPI_Testall(count, requests, flag, statuses);
+}
+
+inline int Start(MPI_Request *request)
+{
+    Call call("MPI_Start", 0.0, 0.0, 1);
+    return MPI_Start(request);
+}
+
+// --- One-sided ---
+
+inline int Get(void *origin, int originCount, MPI_Datatype originType, int target, MPI_Aint displacement,
+               int targetCount, MPI_Datatype targetType, MPI_Win win)
+{
+    Call call("MPI_Get", 0.0, bytes(originCount, originType), 1);
+    return MPI_Get(origin, originCount, originType, target, displacement, targetCount, targetType, win);
+}
+
+inline int Accumulate(const void *origin, int originCount, MPI_Datatype originType, int target,
+                      MPI_Aint displacement, int targetCount, MPI_Datatype targetType, MPI_Op op, MPI_Win win)
+{
+    Call call("MPI_Accumulate", bytes(originCount, originType), 0.0, 1);
+    return MPI_Accumulate(origin, originCount, originType, target, displacement, targetCount, targetType, op, win);
+}
+
+inline int Win_flush(int rank, MPI_Win win)
+{
+    Call call("MPI_Win_flush", 0.0, 0.0, 0);
+    return MPI_Win_flush(rank, win);
+}
+
+inline int Win_flush_all(MPI_Win win)
+{
+    Call call("MPI_Win_flush_all", 0.0, 0.0, 0);
+    return MPI_Win_flush_all(win);
+}
+
+inline int Win_flush_local(int rank, MPI_Win win)
+{
+    Call call("MPI_Win_flush_local", 0.0, 0.0, 0);
+    return MPI_Win_flush_local(rank, win);
+}
+
+inline int Win_sync(MPI_Win win)
+{
+    Call call("MPI_Win_sync", 0.0, 0.0, 0);
+    return MPI_Win_sync(win);
+}
+
+// Window setup and teardown: collective (MPI_Win_free waits for the other processes)
+inline int Win_create(void *base, MPI_Aint size, int dispUnit, MPI_Info info, MPI_Comm comm, MPI_Win *win)
+{
+    Call call("MPI_Win_create", 0.0, 0.0, 0);
+    return MPI_Win_create(base, size, dispUnit, info, comm, win);
+}
+
+inline int Win_lock_all(int assertion, MPI_Win win)
+{
+    Call call("MPI_Win_lock_all", 0.0, 0.0, 0);
+    return MPI_Win_lock_all(assertion, win);
+}
+
+inline int Win_unlock_all(MPI_Win win)
+{
+    Call call("MPI_Win_unlock_all", 0.0, 0.0, 0);
+    return MPI_Win_unlock_all(win);
+}
+
+inline int Win_free(MPI_Win *win)
+{
+    Call call("MPI_Win_free", 0.0, 0.0, 0);
+    return MPI_Win_free(win);
+}
+
+// --- Files: the bytes written count as sent, the bytes read as received ---
+
+inline int File_open(MPI_Comm comm, const char *path, int mode, MPI_Info info, MPI_File *file)
+{
+    Call call("MPI_File_open", 0.0, 0.0, 0);
+    return MPI_File_open(comm, path, mode, info, file);
+}
+
+inline int File_close(MPI_File *file)
+{
+    Call call("MPI_File_close", 0.0, 0.0, 0);
+    return MPI_File_close(file);
+}
+
+inline int File_set_size(MPI_File file, MPI_Offset size)
+{
+    Call call("MPI_File_set_size", 0.0, 0.0, 0);
+    return MPI_File_set_size(file, size);
+}
+
+inline int File_read_at_all(MPI_File file, MPI_Offset offset, void *buf, int count, MPI_Datatype type,
+                            MPI_Status *status)
+{
+    Call call("MPI_File_read_at_all", 0.0, bytes(count, type), 1);
+    return MPI_File_read_at_all(file, offset, buf, count, type, status);
+}
+
+inline int File_write_at(MPI_File file, MPI_Offset offset, const void *buf, int count, MPI_Datatype type,
+                         MPI_Status *status)
+{
+    Call call("MPI_File_write_at", bytes(count, type), 0.0, 1);
+    return MPI_File_write_at(file, offset, buf, count, type, status);
+}
+
+inline int File_write_at_all(MPI_File file, MPI_Offset offset, const void *buf, int count, MPI_Datatype type,
+                             MPI_Status *status)
+{
+    Call call("MPI_File_write_at_all", bytes(count, type), 0.0, 1);
+    return MPI_File_write_at_all(file, offset, buf, count, type, status);
+}
+
+} // namespace profiled_mpi
+
+#define MPI_Bcast profiled_mpi::Bcast
+#define MPI_Ibcast profiled_mpi::Ibcast
+#define MPI_Allreduce profiled_mpi::Allreduce
+#define MPI_Iallreduce profiled_mpi::Iallreduce
+#define MPI_Reduce_scatter profiled_mpi::Reduce_scatter
+#define MPI_Allgather profiled_mpi::Allgather
+#define MPI_Allgatherv profiled_mpi::Allgatherv
+#define MPI_Alltoallw profiled_mpi::Alltoallw
+#define MPI_Barrier profiled_mpi::Barrier
+#define MPI_Send profiled_mpi::Send
+#define MPI_Recv profiled_mpi::Recv
+#define MPI_Irecv profiled_mpi::Irecv
+#define MPI_Wait profiled_mpi::Wait
+#define MPI_Waitall profiled_mpi::Waitall
+#define MPI_Test profiled_mpi::Test
+#define MPI_Testall profiled_mpi::Testall
+#define MPI_Start profiled_mpi::Start
+#define MPI_Get profiled_mpi::Get
+#define MPI_Accumulate profiled_mpi::Accumulate
+#define MPI_Win_flush profiled_mpi::Win_flush
+#define MPI_Win_flush_all profiled_mpi::Win_flush_all
+#define MPI_Win_flush_local profiled_mpi::Win_flush_local
+#define MPI_Win_sync profiled_mpi::Win_sync
+#define MPI_Win_create profiled_mpi::Win_create
+#define MPI_Win_lock_all profiled_mpi::Win_lock_all
+#define MPI_Win_unlock_all profiled_mpi::Win_unlock_all
+#define MPI_Win_free profiled_mpi::Win_free
+#define MPI_File_open profiled_mpi::File_open
+#define MPI_File_close profiled_mpi::File_close
+#define MPI_File_set_size profiled_mpi::File_set_size
+#define MPI_File_read_at_all profiled_mpi::File_read_at_all
+#define MPI_File_write_at profiled_mpi::File_write_at
+#define MPI_File_write_at_all profiled_mpi::File_write_at_all
+
+#endif // MATRIX_INSTRUMENT
+
+#endif // PROFILED_MPI_HPP
@@ -0,0 +1,187 @@
+#include "comm_profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+namespace {
+
+// Statistics aggregated over the processes, in this order
+const int numFields = 6;
+
+std::array<double, numFields> fields(const CommProfiler::ZoneStats &stats)
+{
+    return {static_cast<double>(stats.calls), stats.seconds, stats.mpiSeconds, stats.bytesSent, stats.bytesReceived,
+            static_cast<double>(stats.messages)};
+}
+
+// Names of the entries of every process of `comm`, the same sorted list on all of them
+std::vector<std::string> allNames(const std::map<std::string, CommProfiler::ZoneStats> &entries, MPI_Comm comm)
+{
+    int rank, procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+
+    std::string local;
+    for (const auto &entry : entries)
+        local += entry.first + '\n';
+    int length = static_cast<int>(local.size());
+    std::vector<int> lengths(procs), displs(procs, 0);
+    MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0, comm);
+    for (int p = 1; p < procs; p++)
+        displs[p] = displs[p - 1] + lengths[p - 1];
+    std::string gathered(rank == 0 ? static_cast<size_t>(displs[procs - 1] + lengths[procs - 1]) : 0, '\0');
+    MPI_Gatherv(local.data(), length, MPI_CHAR, &gathered[0], lengths.data(), displs.data(), MPI_CHAR, 0, comm);
+
+    std::string joined;
+    if (rank == 0) {
+        std::set<std::string> names;
+        std::istringstream in(gathered);
+        for (std::string name; std::getline(in, name);)
+            names.insert(name);
+        for (const std::string &name : names)
+            joined += name + '\n';
+    }
+    int size = static_cast<int>(joined.size());
+    MPI_Bcast(&size, 1, MPI_INT, 0, comm);
+    joined.resize(size);
+    MPI_Bcast(&joined[0], size, MPI_CHAR, 0, comm);
+
+    std::vector<std::string> names;
+    std::istringstream in(joined);
+    for (std::string name; std::getline(in, name);)
+        names.push_back(name);
+    return names;
+}
+
+void reportTable(std::ostream &out, const char *title, const std::map<std::string, CommProfiler::ZoneStats> &entries,
+                 MPI_Comm comm)
+{
+    int rank, procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+
+    const std::vector<std::string> names = allNames(entries, comm);
+    std::vector<double> local(names.size() * numFields, 0.0);
+    for (size_t z = 0; z < names.size(); z++) {
+        auto it = entries.find(names[z]);
+        if (it != entries.end()) {
+            std::array<double, numFields> values = fields(it->second);
+            std::copy(values.begin(), values.end(), local.begin() + z * numFields);
+        }
+    }
+    std::vector<double> sums(local.size()), maxima(local.size());
+    MPI_Reduce(local.data(), sums.data(), static_cast<int>(local.size()), MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(local.data(), maxima.data(), static_cast<int>(local.size()), MPI_DOUBLE, MPI_MAX, 0, comm);
+    if (rank != 0)
+        return;
+
+    out << std::left << std::setw(48) << title << std::right << std::setw(8) << "calls" << std::setw(12) << "max (s)"
+        << std::setw(12) << "mean (s)" << std::setw(10) << "max/mean" << std::setw(12) << "MPI (s)" << std::setw(8)
+        << "comm %" << std::setw(14) << "sent (B)" << std::setw(14) << "recv (B)" << std::setw(10) << "messages"
+        << std::endl;
+    for (size_t z = 0; z < names.size(); z++) {
+        const double *sum = sums.data() + z * numFields;
+        const double *max = maxima.data() + z * numFields;
+        const double meanSeconds = sum[1] / procs;
+        out << std::left << std::setw(48) << names[z] << std::right << std::setw(8) << static_cast<long>(max[0])
+            << std::setw(12) << std::setprecision(4) << max[1] << std::setw(12) << meanSeconds << std::setw(10)
+            << std::setprecision(3) << (meanSeconds > 0 ? max[1] / meanSeconds : 1.0) << std::setw(12)
+            << std::setprecision(4) << sum[2] / procs << std::setw(8) << std::setprecision(3)
+            << (sum[1] > 0 ? 100.0 * sum[2] / sum[1] : 0.0) << std::setw(14) << std::setprecision(6) << sum[3] / procs
+            << std::setw(14) << sum[4] / procs << std::setw(10) << sum[5] / procs << std::endl;
+    }
+}
+
+struct FinalizeProfile {
+    CommProfiler profiler;
+    std::ostream *out;
+};
+
+int reportAtFinalize(MPI_Comm, int, void *attribute, void *)
+{
+    FinalizeProfile *profile = static_cast<FinalizeProfile *>(attribute);
+    instrumentation::removeListener(&profile->profiler);
+    profile->profiler.report(*profile->out);
+    delete profile;
+    return MPI_SUCCESS;
+}
+
+} // namespace
+
+void CommProfiler::enterZone(const char *name)
+{
+    stack_.push_back({name, MPI_Wtime()});
+}
+
+void CommProfiler::exitZone(const char *name)
+{
+    double end = MPI_Wtime();
+    if (stack_.empty() || stack_.back().name != name)
+        return; // Unbalanced zones (listener attached in the middle of a zone)
+    OpenZone zone = stack_.back();
+    stack_.pop_back();
+
+    ZoneStats &stats = zones_[zone.name];
+    stats.calls++;
+    stats.seconds += end - zone.start;
+}
+
+void CommProfiler::communication(const char *call, double seconds, double bytesSent, double bytesReceived, int messages)
+{
+    auto add = [&](ZoneStats &stats) {
+        stats.mpiSeconds += seconds;
+        stats.bytesSent += bytesSent;
+        stats.bytesReceived += bytesReceived;
+        stats.messages += messages;
+    };
+    ZoneStats &callStats = calls_[call];
+    callStats.calls++;
+    callStats.seconds += seconds;
+    add(callStats);
+    // Every open zone includes the call, once even if it is open several times (recursion)
+    for (size_t z = 0; z < stack_.size(); z++) {
+        bool repeated = false;
+        for (size_t outer = 0; outer < z && !repeated; outer++)
+            repeated = stack_[outer].name == stack_[z].name;
+        if (!repeated)
+            add(zones_[stack_[z].name]);
+    }
+}
+
+const std::map<std::string, CommProfiler::ZoneStats> &CommProfiler::zones() const
+{
+    return zones_;
+}
+
+const std::map<std::string, CommProfiler::ZoneStats> &CommProfiler::calls() const
+{
+    return calls_;
+}
+
+void CommProfiler::report(std::ostream &out, MPI_Comm comm) const
+{
+    int procs;
+    MPI_Comm_size(comm, &procs);
+    std::ostringstream table; // Written at once by rank 0
+    reportTable(table, "zone", zones_, comm);
+    table << std::endl;
+    reportTable(table, "MPI call", calls_, comm);
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0)
+        out << "Communication profile over " << procs << " processes (per process: mean, or max)" << std::endl
+            << table.str() << std::flush;
+}
+
+void CommProfiler::profileUntilFinalize(std::ostream &out)
+{
+    FinalizeProfile *profile = new FinalizeProfile;
+    profile->out = &out;
+    instrumentation::addListener(&profile->profiler);
+    // MPI_Finalize frees the attributes of MPI_COMM_SELF first, while MPI is still usable
+    int keyval;
+    MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, reportAtFinalize, &keyval, nullptr);
+    MPI_Comm_set_attr(MPI_COMM_SELF, keyval, profile);
+}
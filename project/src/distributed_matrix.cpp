@@ -1,108 +1,1688 @@
 #include "distributed_matrix.hpp"
+#include "instrumentation.hpp"
+#include "profiled_mpi.hpp" // With MATRIX_INSTRUMENT, the MPI calls below are profiled
 #include <stdexcept>
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(OPEN_MPI) && MPI_VERSION < 4
+#include <mpi-ext.h> // MPIX_ persistent collectives
+#endif
 
-// The matrix is split by columns across MPI processes.
-// Each process stores a local Matrix with a subset of columns.
-// Columns are distributed as evenly as possible.
+// Each process of a Pr x Pc grid stores a local Matrix with the elements of the rows and
+// columns it owns (see IndexDistribution), in the same order as in the global matrix.
+// With the default column layout the grid is 1 x P and the columns are split in contiguous
+// parts as equal as possible.
+
+namespace {
+
+// --- Cleanup at MPI_Finalize ---
+
+// Callbacks run by MPI_Finalize in reverse order of registration, e.g. to free cached
+// communicators and requests while MPI is still usable. They are run by the delete callback
+// of an attribute of MPI_COMM_SELF, which MPI_Finalize calls before shutting down.
+std::vector<std::function<void()>>& finalizers()
+{
+    static std::vector<std::function<void()>> callbacks;
+    return callbacks;
+}
+
+int runFinalizers(MPI_Comm, int, void*, void*)
+{
+    auto& callbacks = finalizers();
+    for (auto it = callbacks.rbegin(); it != callbacks.rend(); ++it)
+        (*it)();
+    callbacks.clear();
+    return MPI_SUCCESS;
+}
+
+void atFinalize(const std::function<void()>& callback)
+{
+    if (finalizers().empty()) {
+        int keyval;
+        MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, runFinalizers, &keyval, nullptr);
+        MPI_Comm_set_attr(MPI_COMM_SELF, keyval, nullptr);
+    }
+    finalizers().push_back(callback);
+}
+
+// --- Process grids ---
+
+void releaseWhenFreed(MPI_Comm comm);
+
+// Grid communicators are created once per communicator and shape, and freed by MPI_Finalize
+// (or with the communicator they are built on).
+typedef std::tuple<MPI_Comm, int, int> GridKey;
+
+std::map<GridKey, std::shared_ptr<ProcessGrid>>& gridCache()
+{
+    static std::map<GridKey, std::shared_ptr<ProcessGrid>> cache;
+    return cache;
+}
+
+// Frees the communicators of a grid
+void release(ProcessGrid& grid)
+{
+    MPI_Comm_free(&grid.rowComm);
+    MPI_Comm_free(&grid.colComm);
+    MPI_Comm_free(&grid.comm);
+}
+
+void freeGrids()
+{
+    for (auto& entry : gridCache())
+        release(*entry.second);
+    gridCache().clear();
+}
+
+std::shared_ptr<const ProcessGrid> processGrid(int rows, int cols, MPI_Comm base)
+{
+    auto& cache = gridCache();
+    auto found = cache.find(GridKey(base, rows, cols));
+    if (found != cache.end())
+        return found->second;
+
+    if (cache.empty())
+        atFinalize(freeGrids);
+    releaseWhenFreed(base);
+    auto grid = std::make_shared<ProcessGrid>();
+    grid->rows = rows;
+    grid->cols = cols;
+    int dims[2] = {rows, cols}, periods[2] = {0, 0}, coords[2];
+    // No reordering: the rank in the grid is the rank in `base`
+    MPI_Cart_create(base, 2, dims, periods, 0, &grid->comm);
+    int rank;
+    MPI_Comm_rank(grid->comm, &rank);
+    MPI_Cart_coords(grid->comm, rank, 2, coords);
+    grid->myRow = coords[0];
+    grid->myCol = coords[1];
+    int keepCols[2] = {0, 1}, keepRows[2] = {1, 0};
+    MPI_Cart_sub(grid->comm, keepCols, &grid->rowComm);
+    MPI_Cart_sub(grid->comm, keepRows, &grid->colComm);
+    cache[GridKey(base, rows, cols)] = grid;
+    return grid;
+}
+
+// --- Shared-memory nodes ---
+
+// Processes of a communicator that share the memory of this one (MPI_COMM_TYPE_SHARED)
+struct NodeComms {
+    MPI_Comm node;    // Processes of this node, ranked as in the communicator
+    MPI_Comm leaders; // First process of every node (MPI_COMM_NULL on the other processes)
+    int leaderRank;   // Rank in `leaders` of the first process of this node
+};
+
+std::map<MPI_Comm, NodeComms>& nodeCommsCache()
+{
+    static std::map<MPI_Comm, NodeComms> cache;
+    return cache;
+}
+
+// Frees the communicators of a node
+void release(NodeComms& comms)
+{
+    MPI_Comm_free(&comms.node);
+    if (comms.leaders != MPI_COMM_NULL)
+        MPI_Comm_free(&comms.leaders);
+}
+
+void freeNodeComms()
+{
+    for (auto& entry : nodeCommsCache())
+        release(entry.second);
+    nodeCommsCache().clear();
+}
+
+const NodeComms& nodeComms(MPI_Comm comm)
+{
+    auto& cache = nodeCommsCache();
+    auto found = cache.find(comm);
+    if (found != cache.end())
+        return found->second;
+
+    if (cache.empty())
+        atFinalize(freeNodeComms);
+    releaseWhenFreed(comm);
+    NodeComms comms;
+    int rank, nodeRank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &comms.node);
+    MPI_Comm_rank(comms.node, &nodeRank);
+    MPI_Comm_split(comm, nodeRank == 0 ? 0 : MPI_UNDEFINED, rank, &comms.leaders);
+    comms.leaderRank = 0;
+    if (comms.leaders != MPI_COMM_NULL)
+        MPI_Comm_rank(comms.leaders, &comms.leaderRank);
+    MPI_Bcast(&comms.leaderRank, 1, MPI_INT, 0, comms.node);
+    return cache[comm] = comms;
+}
+
+// --- Persistent collectives ---
+//
+// Iterative solvers call sum(), gather() and sync_matrix() thousands of times with the same
+// shapes. The first call for a shape creates a persistent collective request (MPI 4, or the
+// MPIX_ extension of Open MPI) bound to buffers owned by the cache; later calls only copy
+// their data in and out of these buffers and start the request, skipping the setup of the
+// collective. Without persistent collectives, the standard collectives are used.
+//
+// All the processes of a communicator call its collectives in the same order with the same
+// shapes, so their caches of this communicator hit, miss and evict identically (a request is
+// created collectively on a miss).
+
+#if MPI_VERSION >= 4
+#define MATRIX_PERSISTENT_COLLECTIVES
+#define MATRIX_PERSISTENT_DEFAULT true
+#define MATRIX_ALLREDUCE_INIT MPI_Allreduce_init
+#define MATRIX_BCAST_INIT MPI_Bcast_init
+#define MATRIX_ALLGATHERV_INIT MPI_Allgatherv_init
+#elif defined(OMPI_HAVE_MPI_EXT_PCOLLREQ)
+// Open MPI 4 implements its MPIX_ persistent collectives as non-blocking schedules, slower
+// than its blocking collectives for small messages: only used if asked for.
+#define MATRIX_PERSISTENT_COLLECTIVES
+#define MATRIX_PERSISTENT_DEFAULT false
+#define MATRIX_ALLREDUCE_INIT MPIX_Allreduce_init
+#define MATRIX_BCAST_INIT MPIX_Bcast_init
+#define MATRIX_ALLGATHERV_INIT MPIX_Allgatherv_init
+#endif
+
+#ifdef MATRIX_PERSISTENT_COLLECTIVES
+// MATRIX_PERSISTENT_COLLECTIVES=0 or 1 in the environment (of all processes) overrides the default
+bool persistentCollectives()
+{
+    static const bool enabled = [] {
+        const char* value = std::getenv("MATRIX_PERSISTENT_COLLECTIVES");
+        return value ? std::string(value) != "0" : MATRIX_PERSISTENT_DEFAULT;
+    }();
+    return enabled;
+}
+#endif
+
+// Above this many elements, the copies in and out of the cached buffers would cost more than
+// the setup they save: the data goes straight to a standard collective.
+const long persistentMaxElements = 1L << 16;
+
+// Number of cached shapes per communicator, the least recently used ones are freed first
+const size_t collectiveCacheSize = 64;
+
+enum CollectiveKind { AllreduceSum, GatherBlocks, GatherTransposed, BcastDims, BcastData };
+
+// Kind, then the parameters of the collective
+typedef std::array<long, 5> CollectiveKey;
+
+struct CachedCollective {
+    MPI_Request request = MPI_REQUEST_NULL; // Persistent request, if any
+    std::vector<double> send, recv;         // Buffers bound to the request
+    std::vector<int> ints;                  // Integer buffer bound to the request
+    std::vector<int> counts, displs;        // Layout of the gathered blocks
+    std::vector<MPI_Datatype> types;        // Derived datatypes describing the blocks
+};
+
+// Frees the MPI objects of a collective
+void release(CachedCollective& collective)
+{
+    if (collective.request != MPI_REQUEST_NULL)
+        MPI_Request_free(&collective.request);
+    for (MPI_Datatype& type : collective.types)
+        if (type != MPI_DATATYPE_NULL)
+            MPI_Type_free(&type);
+}
+
+// A miss sets up a collective request (MPI_*_init, itself collective), so every process of a
+// communicator must hit, miss and evict identically: each communicator has its own entries and
+// its own LRU order, which only its collectives change, whatever the traffic on the others.
+class CollectiveCache
+{
+public:
+    // Entry of `key` on `comm`; `created` tells whether the entry is new and its request must be set up
+    CachedCollective& find(MPI_Comm comm, const CollectiveKey& key, bool& created)
+    {
+        if (!registered) {
+            atFinalize([this] { clear(); });
+            registered = true;
+        }
+        Entries& cache = caches[comm];
+        auto found = cache.entries.find(key);
+        created = found == cache.entries.end();
+        if (!created) {
+            cache.order.splice(cache.order.begin(), cache.order, found->second.second);
+            return *found->second.first;
+        }
+        if (cache.entries.size() == collectiveCacheSize) {
+            auto last = cache.entries.find(cache.order.back());
+            release(*last->second.first);
+            cache.entries.erase(last);
+            cache.order.pop_back();
+        }
+        cache.order.push_front(key);
+        auto& entry = cache.entries[key];
+        entry.first.reset(new CachedCollective);
+        entry.second = cache.order.begin();
+        return *entry.first;
+    }
+
+    // Frees the entries of `comm` (before it is freed)
+    void erase(MPI_Comm comm)
+    {
+        auto found = caches.find(comm);
+        if (found == caches.end())
+            return;
+        for (auto& entry : found->second.entries)
+            release(*entry.second.first);
+        caches.erase(found);
+    }
+
+    void clear()
+    {
+        for (auto& cache : caches)
+            for (auto& entry : cache.second.entries)
+                release(*entry.second.first);
+        caches.clear();
+    }
+
+private:
+    struct Entries {
+        std::map<CollectiveKey, std::pair<std::unique_ptr<CachedCollective>, std::list<CollectiveKey>::iterator>>
+            entries;
+        std::list<CollectiveKey> order; // Most recently used first
+    };
+
+    std::map<MPI_Comm, Entries> caches;
+    bool registered = false; // Whether clear() runs at MPI_Finalize
+};
+
+CollectiveCache& collectiveCache()
+{
+    static CollectiveCache cache;
+    return cache;
+}
+
+// --- Communicators of the user ---
+
+// A communicator other than MPI_COMM_WORLD may be freed, and its handle reused by a new one,
+// before MPI_Finalize: an attribute of it releases the grids, node communicators and cached
+// collectives built on it when it is freed. Only their own cache entries go: the other
+// communicators keep theirs, and the processes outside of it stay in step with those inside.
+void releaseNodeComms(MPI_Comm comm)
+{
+    auto nodes = nodeCommsCache().find(comm);
+    if (nodes == nodeCommsCache().end())
+        return;
+    collectiveCache().erase(nodes->second.node);
+    collectiveCache().erase(nodes->second.leaders);
+    release(nodes->second);
+    nodeCommsCache().erase(nodes);
+}
+
+int releaseDerived(MPI_Comm comm, int, void*, void*)
+{
+    auto& grids = gridCache();
+    for (auto it = grids.begin(); it != grids.end();) {
+        if (std::get<0>(it->first) != comm) {
+            ++it;
+            continue;
+        }
+        const ProcessGrid& grid = *it->second;
+        releaseNodeComms(grid.comm);
+        for (MPI_Comm derived : {grid.comm, grid.rowComm, grid.colComm})
+            collectiveCache().erase(derived);
+        release(*it->second);
+        it = grids.erase(it);
+    }
+    releaseNodeComms(comm);
+    collectiveCache().erase(comm);
+    return MPI_SUCCESS;
+}
+
+void releaseWhenFreed(MPI_Comm comm)
+{
+    static int keyval = MPI_KEYVAL_INVALID;
+    if (comm == MPI_COMM_WORLD)
+        return;
+    if (keyval == MPI_KEYVAL_INVALID)
+        MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, releaseDerived, &keyval, nullptr);
+    void* value;
+    int present;
+    MPI_Comm_get_attr(comm, keyval, &value, &present);
+    if (!present)
+        MPI_Comm_set_attr(comm, keyval, nullptr);
+}
+
+CachedCollective& cachedCollective(CollectiveKind kind, MPI_Comm comm, long a, long b = 0, long c = 0, long d = 0)
+{
+    bool created;
+    return collectiveCache().find(comm, {kind, a, b, c, d}, created);
+}
+
+#ifdef MATRIX_PERSISTENT_COLLECTIVES
+// Runs a persistent request to completion
+void startAndWait(MPI_Request& request)
+{
+    MPI_Start(&request);
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+}
+#endif
+
+double allreduceSum(double value, MPI_Comm comm)
+{
+#ifdef MATRIX_PERSISTENT_COLLECTIVES
+    if (persistentCollectives()) {
+        CachedCollective& collective = cachedCollective(AllreduceSum, comm, 1);
+        if (collective.request == MPI_REQUEST_NULL) {
+            collective.send.resize(1);
+            collective.recv.resize(1);
+            MATRIX_ALLREDUCE_INIT(collective.send.data(), collective.recv.data(), 1, MPI_DOUBLE, MPI_SUM, comm,
+                                  MPI_INFO_NULL, &collective.request);
+        }
+        collective.send[0] = value;
+        startAndWait(collective.request);
+        return collective.recv[0];
+    }
+#endif
+    double total = 0.0;
+    MPI_Allreduce(&value, &total, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return total;
+}
+
+// --- Zero-copy gathers ---
+//
+// gather() and transpose() receive every local block straight into its place in the full
+// matrix (or its transpose), described by MPI derived datatypes that are cached per shape:
+// the MPI library does the packing and unpacking, without intermediate buffers.
+
+// Type of one column of a row-major matrix with `ld` columns, resized to one element so that
+// consecutive columns follow each other (count and displacements are counted in columns)
+MPI_Datatype columnType(int rows, int ld)
+{
+    MPI_Datatype column, resized;
+    MPI_Type_vector(rows, 1, ld, MPI_DOUBLE, &column);
+    MPI_Type_create_resized(column, 0, sizeof(double), &resized);
+    MPI_Type_commit(&resized);
+    MPI_Type_free(&column);
+    return resized;
+}
+
+// Runs of consecutive global indices owned by process p: `starts[r]`, `lengths[r]`
+void indexRuns(const IndexDistribution& dist, int p, std::vector<int>& starts, std::vector<int>& lengths)
+{
+    const int size = dist.localSize(p);
+    for (int l = 0; l < size;) {
+        int run = dist.block == 0 ? size : std::min(size - l, dist.block - l % dist.block);
+        starts.push_back(dist.toGlobal(p, l));
+        lengths.push_back(run);
+        l += run;
+    }
+}
+
+// Positions, in a row-major matrix with `ld` columns, of the elements of rows `rows` (owned by
+// pRow) and columns `cols` (owned by pCol), in row-major order of the local block
+MPI_Datatype scatteredBlockType(const IndexDistribution& rows, int pRow, const IndexDistribution& cols, int pCol, int ld)
+{
+    std::vector<int> colStarts, colLengths, rowStarts, rowLengths;
+    indexRuns(cols, pCol, colStarts, colLengths);
+    indexRuns(rows, pRow, rowStarts, rowLengths);
+    MPI_Datatype row, fullRow, block;
+    MPI_Type_indexed(static_cast<int>(colStarts.size()), colLengths.data(), colStarts.data(), MPI_DOUBLE, &row);
+    MPI_Type_create_resized(row, 0, static_cast<MPI_Aint>(ld) * sizeof(double), &fullRow);
+    MPI_Type_indexed(static_cast<int>(rowStarts.size()), rowLengths.data(), rowStarts.data(), fullRow, &block);
+    MPI_Type_commit(&block);
+    MPI_Type_free(&row);
+    MPI_Type_free(&fullRow);
+    return block;
+}
+
+// Gathers `matrix` (or its transpose) into `out` on every process
+void gatherInto(const DistributedMatrix& matrix, double* out, bool transposed)
+{
+    const ProcessGrid& grid = matrix.getGrid();
+    const IndexDistribution& rowDist = matrix.getRowDistribution();
+    const IndexDistribution& colDist = matrix.getColDistribution();
+    const Matrix& local = matrix.getLocalData();
+    const int rows = matrix.numRows(), cols = matrix.numCols();
+    const int numProcs = grid.rows * grid.cols;
+    // Distributions with explicit offsets are not identified by the key of the cache: their
+    // types are built for this call only
+    CachedCollective uncached;
+    const bool cached = rowDist.offsets.empty() && colDist.offsets.empty();
+    CachedCollective& collective =
+        cached ? cachedCollective(transposed ? GatherTransposed : GatherBlocks, grid.comm, rows, cols, rowDist.block,
+                                  colDist.block)
+               : uncached;
+    std::vector<int>& counts = collective.counts;
+    std::vector<int>& displs = collective.displs;
+    std::vector<MPI_Datatype>& types = collective.types;
+    // The local block sent column by column (for the transpose)
+    auto localColumns = [&] {
+        MPI_Datatype columns, column = columnType(local.numRows(), local.numCols());
+        MPI_Type_contiguous(local.numCols(), column, &columns);
+        MPI_Type_commit(&columns);
+        MPI_Type_free(&column);
+        return columns;
+    };
+
+    // 1D layouts: the blocks are contiguous ranges of columns (Layout::Columns) or of rows
+    // (Layout::Rows), that is of rows or of columns of the transpose. One MPI_Allgatherv puts
+    // every block in place, counted in rows (contiguous) or in columns (a column type resized
+    // to one element), the local block being sent row by row or column by column to match.
+    const bool byColumns = rowDist.procs == 1 && colDist.block == 0;
+    const bool byRows = !byColumns && colDist.procs == 1 && rowDist.block == 0;
+    if (byColumns || byRows) {
+        if (counts.empty()) {
+            const IndexDistribution& dist = byColumns ? colDist : rowDist;
+            // Rows of `out` are received as elements (`unit` per row), columns with a column type
+            const int unit = byColumns == transposed ? (transposed ? rows : cols) : 1;
+            counts.resize(numProcs);
+            displs.resize(numProcs);
+            for (int p = 0; p < numProcs; p++) {
+                counts[p] = unit * dist.localSize(p);
+                displs[p] = unit * dist.toGlobal(p, 0);
+            }
+            MPI_Datatype sendType, recvType;
+            if (byColumns) {
+                sendType = columnType(local.numRows(), local.numCols());
+            } else {
+                MPI_Type_contiguous(local.numCols(), MPI_DOUBLE, &sendType);
+                MPI_Type_commit(&sendType);
+            }
+            if (byColumns != transposed) {
+                // `out` is rows x cols, or cols x rows for the transpose
+                recvType = byColumns ? columnType(rows, cols) : columnType(cols, rows);
+            } else {
+                MPI_Type_contiguous(1, MPI_DOUBLE, &recvType);
+                MPI_Type_commit(&recvType);
+            }
+            types = {sendType, recvType};
+        }
+        // The local block is sent in units of the other dimension: a column (matrix by columns)
+        // or a row (matrix by rows) each
+        const int sendCount = byColumns ? local.numCols() : local.numRows();
+#ifdef MATRIX_PERSISTENT_COLLECTIVES
+        if (cached && persistentCollectives() && static_cast<long>(rows) * cols <= persistentMaxElements) {
+            if (collective.request == MPI_REQUEST_NULL) {
+                collective.send.resize(static_cast<size_t>(local.numRows()) * local.numCols());
+                collective.recv.resize(static_cast<size_t>(rows) * cols);
+                MATRIX_ALLGATHERV_INIT(collective.send.data(), sendCount, types[0], collective.recv.data(),
+                                       counts.data(), displs.data(), types[1], grid.comm, MPI_INFO_NULL,
+                                       &collective.request);
+            }
+            std::copy(local.rawData(), local.rawData() + collective.send.size(), collective.send.data());
+            startAndWait(collective.request);
+            std::copy(collective.recv.begin(), collective.recv.end(), out);
+            return;
+        }
+#endif
+        MPI_Allgatherv(local.rawData(), sendCount, types[0], out, counts.data(), displs.data(), types[1], grid.comm);
+        release(uncached);
+        return;
+    }
+
+    // Otherwise (a 2D grid, or blocks dealt round-robin, whose positions in `out` differ from
+    // one process to the next by more than an offset, so no single receive type of
+    // MPI_Allgatherv fits them all) every process sends its block to every process
+    // (MPI_Alltoallw), received with a datatype per source that scatters it to its rows and columns: row segments of the
+    // block, rather than single elements, as long as the result is not transposed.
+    if (counts.empty()) {
+        counts.assign(numProcs, 1);
+        displs.assign(numProcs, 0);
+        types.resize(numProcs + 1);
+        for (int p = 0; p < numProcs; p++)
+            types[p] = transposed ? scatteredBlockType(colDist, p % grid.cols, rowDist, p / grid.cols, rows)
+                                  : scatteredBlockType(rowDist, p / grid.cols, colDist, p % grid.cols, cols);
+        if (transposed) {
+            types[numProcs] = localColumns();
+        } else {
+            MPI_Type_contiguous(local.numRows() * local.numCols(), MPI_DOUBLE, &types[numProcs]);
+            MPI_Type_commit(&types[numProcs]);
+        }
+    }
+    std::vector<MPI_Datatype> sendTypes(numProcs, types[numProcs]);
+    MPI_Alltoallw(local.rawData(), counts.data(), displs.data(), sendTypes.data(),
+                  out, counts.data(), displs.data(), types.data(), grid.comm);
+    release(uncached);
+}
+
+// Positions of the local block of `matrix` in the full row-major matrix
+MPI_Datatype localBlockType(const DistributedMatrix& matrix)
+{
+    const ProcessGrid& grid = matrix.getGrid();
+    return scatteredBlockType(matrix.getRowDistribution(), grid.myRow, matrix.getColDistribution(), grid.myCol,
+                              matrix.numCols());
+}
+
+// One row of the local block, so that counts stay small for very large blocks
+MPI_Datatype localRowType(const DistributedMatrix& matrix)
+{
+    MPI_Datatype row;
+    MPI_Type_contiguous(matrix.getLocalData().numCols(), MPI_DOUBLE, &row);
+    MPI_Type_commit(&row);
+    return row;
+}
+
+// --- Binary files ---
+
+// Number of rows and of columns, as 64-bit integers, before the elements
+const MPI_Offset fileHeaderBytes = 2 * sizeof(int64_t);
+
+void checkFileError(int error, const std::string& what, const std::string& path)
+{
+    if (error != MPI_SUCCESS) {
+        char message[MPI_MAX_ERROR_STRING];
+        int length;
+        MPI_Error_string(error, message, &length);
+        throw std::runtime_error("Cannot " + what + " " + path + ": " + std::string(message, length));
+    }
+}
+
+// Pr x Pc grid with Pr <= Pc as close as possible to a square, which minimizes the
+// amount of data exchanged along the grid rows and columns
+std::pair<int, int> squarestGrid(int numProcs)
+{
+    int rows = static_cast<int>(std::sqrt(static_cast<double>(numProcs)));
+    while (numProcs % rows != 0)
+        rows--;
+    return {rows, numProcs / rows};
+}
+
+// Contiguous split of `n` indices with the sizes chosen by `partitioner`; a split as equal
+// as possible is stored without offsets, like the default distribution
+IndexDistribution partitioned(int n, int procs, const Partitioner& partitioner)
+{
+    std::vector<int> sizes = partitioner.partition(n, procs);
+    if (static_cast<int>(sizes.size()) != procs)
+        throw std::invalid_argument("Partitioner must give one size per process");
+    IndexDistribution dist{n, procs, 0, {}};
+    dist.offsets.assign(procs + 1, 0);
+    for (int p = 0; p < procs; p++) {
+        if (sizes[p] < 0)
+            throw std::invalid_argument("Partitioner sizes must be non-negative");
+        dist.offsets[p + 1] = dist.offsets[p] + sizes[p];
+    }
+    if (dist.offsets[procs] != n)
+        throw std::invalid_argument("Partitioner sizes must add up to the number of columns");
+    if (sizes == EqualPartitioner().partition(n, procs))
+        dist.offsets.clear();
+    return dist;
+}
+
+// `dist` for `n` indices: itself if it has `n` indices, else the same kind of split
+IndexDistribution resized(const IndexDistribution& dist, int n)
+{
+    if (n == dist.n)
+        return dist;
+    return {n, dist.procs, dist.block, {}};
+}
+
+// Layout chosen by Layout::Auto: the 2D grid only pays off when it has more than one row
+// (the number of processes is not prime) and no grid row or column is left without a block
+DistributedMatrix::Layout autoLayout(int rows, int cols, int numProcs, int blockSize)
+{
+    std::pair<int, int> shape = squarestGrid(numProcs);
+    if (blockSize > 0 && shape.first > 1 &&
+        rows >= shape.first * blockSize && cols >= shape.second * blockSize)
+        return DistributedMatrix::Layout::BlockCyclic;
+    return DistributedMatrix::Layout::Columns;
+}
+
+// Grid of the processes for `layout`
+std::shared_ptr<const ProcessGrid> layoutGrid(DistributedMatrix::Layout layout, int numProcs, MPI_Comm comm)
+{
+    std::pair<int, int> shape = layout == DistributedMatrix::Layout::Columns ? std::make_pair(1, numProcs)
+                                : layout == DistributedMatrix::Layout::Rows  ? std::make_pair(numProcs, 1)
+                                                                             : squarestGrid(numProcs);
+    return processGrid(shape.first, shape.second, comm);
+}
+
+void checkSamePartitioning(const DistributedMatrix& a, const DistributedMatrix& b, const char* op)
+{
+    if (a.numRows() != b.numRows() || a.numCols() != b.numCols() ||
+        !(a.getRowDistribution() == b.getRowDistribution()) ||
+        !(a.getColDistribution() == b.getColDistribution()) ||
+        a.getGrid().comm != b.getGrid().comm)
+        throw std::invalid_argument(std::string("DistributedMatrix dimensions must match for ") + op);
+}
+
+} // namespace
+
+// --- IndexDistribution ---
+
+int IndexDistribution::localSize(int p) const
+{
+    if (!offsets.empty())
+        return offsets[p + 1] - offsets[p];
+    if (block == 0)
+        return n / procs + (p < n % procs ? 1 : 0);
+    int numBlocks = (n + block - 1) / block;
+    int size = (numBlocks / procs + (p < numBlocks % procs ? 1 : 0)) * block;
+    // The last block may be partial
+    if (numBlocks > 0 && p == (numBlocks - 1) % procs)
+        size -= numBlocks * block - n;
+    return size;
+}
+
+int IndexDistribution::owner(int global) const
+{
+    if (block != 0)
+        return (global / block) % procs;
+    if (!offsets.empty()) // Last process whose first index is <= global (skipping empty parts)
+        return static_cast<int>(std::upper_bound(offsets.begin(), offsets.end() - 1, global) - offsets.begin()) - 1;
+    int base = n / procs;
+    int remainder = n % procs;
+    // The first `remainder` processes own `base + 1` indices each
+    if (global < remainder * (base + 1))
+        return global / (base + 1);
+    return remainder + (global - remainder * (base + 1)) / base;
+}
+
+int IndexDistribution::toLocal(int global) const
+{
+    if (block != 0)
+        return global / (block * procs) * block + global % block;
+    return global - toGlobal(owner(global), 0);
+}
+
+int IndexDistribution::toGlobal(int p, int local) const
+{
+    if (block != 0)
+        return (local / block * procs + p) * block + local % block;
+    if (!offsets.empty())
+        return offsets[p] + local;
+    return p * (n / procs) + std::min(p, n % procs) + local;
+}
+
+bool IndexDistribution::operator==(const IndexDistribution& other) const
+{
+    return n == other.n && procs == other.procs && block == other.block && offsets == other.offsets;
+}
+
+// --- Partitioners ---
+
+namespace {
+
+// Contiguous parts of `prefix` (prefix[j]: cost of the indices before j) whose costs are
+// proportional to `speeds`: each boundary is the index whose prefix cost is the closest to
+// the cumulated target
+std::vector<int> balancedParts(const std::vector<double>& prefix, const std::vector<double>& speeds)
+{
+    const int n = static_cast<int>(prefix.size()) - 1;
+    const int procs = static_cast<int>(speeds.size());
+    double totalSpeed = 0.0;
+    for (double speed : speeds)
+        totalSpeed += speed;
+    std::vector<int> sizes(procs);
+    double target = 0.0;
+    int begin = 0;
+    for (int p = 0; p < procs; p++) {
+        target += prefix[n] * speeds[p] / totalSpeed;
+        int end = n;
+        if (p < procs - 1) {
+            end = static_cast<int>(std::lower_bound(prefix.begin() + begin, prefix.end(), target) - prefix.begin());
+            if (end > begin && (end > n || target - prefix[end - 1] < prefix[end] - target))
+                end--;
+            end = std::min(end, n);
+        }
+        sizes[p] = end - begin;
+        begin = end;
+    }
+    return sizes;
+}
+
+std::vector<double> unitPrefix(int n)
+{
+    std::vector<double> prefix(n + 1);
+    for (int j = 0; j <= n; j++)
+        prefix[j] = j;
+    return prefix;
+}
+
+void checkSpeeds(const std::vector<double>& speeds)
+{
+    for (double speed : speeds)
+        if (!(speed > 0.0) || !std::isfinite(speed))
+            throw std::invalid_argument("Partitioner speeds must be positive");
+}
+
+} // namespace
+
+std::vector<int> EqualPartitioner::partition(int n, int procs) const
+{
+    std::vector<int> sizes(procs);
+    for (int p = 0; p < procs; p++)
+        sizes[p] = n / procs + (p < n % procs ? 1 : 0);
+    return sizes;
+}
+
+WeightedPartitioner::WeightedPartitioner(std::vector<double> speeds) : speeds(std::move(speeds))
+{
+    checkSpeeds(this->speeds);
+}
+
+WeightedPartitioner WeightedPartitioner::measured(const DistributedMatrix& matrix, double seconds)
+{
+    const ProcessGrid& grid = matrix.getGrid();
+    // A process without columns, or too fast to be timed, counts as the fastest one
+    double speed = seconds > 0.0 ? matrix.getLocalData().numCols() / seconds : 0.0;
+    std::vector<double> speeds(grid.rows * grid.cols);
+    MPI_Allgather(&speed, 1, MPI_DOUBLE, speeds.data(), 1, MPI_DOUBLE, grid.comm);
+    double fastest = *std::max_element(speeds.begin(), speeds.end());
+    for (double& s : speeds)
+        if (!(s > 0.0))
+            s = fastest > 0.0 ? fastest : 1.0;
+    return WeightedPartitioner(speeds);
+}
+
+std::vector<int> WeightedPartitioner::partition(int n, int procs) const
+{
+    if (static_cast<int>(speeds.size()) != procs)
+        throw std::invalid_argument("WeightedPartitioner needs one speed per process");
+    return balancedParts(unitPrefix(n), speeds);
+}
+
+const std::vector<double>& WeightedPartitioner::getSpeeds() const { return speeds; }
+
+CostPartitioner::CostPartitioner(std::vector<double> costs, std::vector<double> speeds)
+    : costs(std::move(costs)), speeds(std::move(speeds))
+{
+    for (double cost : this->costs)
+        if (!(cost >= 0.0) || !std::isfinite(cost))
+            throw std::invalid_argument("CostPartitioner costs must be non-negative");
+    checkSpeeds(this->speeds);
+}
+
+std::vector<int> CostPartitioner::partition(int n, int procs) const
+{
+    if (static_cast<int>(costs.size()) != n)
+        throw std::invalid_argument("CostPartitioner needs one cost per column");
+    if (!speeds.empty() && static_cast<int>(speeds.size()) != procs)
+        throw std::invalid_argument("CostPartitioner needs one speed per process");
+    std::vector<double> prefix(n + 1, 0.0);
+    for (int j = 0; j < n; j++)
+        prefix[j + 1] = prefix[j] + costs[j];
+    // Without any cost, every column costs the same
+    if (prefix[n] == 0.0)
+        prefix = unitPrefix(n);
+    return balancedParts(prefix, speeds.empty() ? std::vector<double>(procs, 1.0) : speeds);
+}
+
+// --- Compressed collectives ---
+
+namespace {
+
+// IEEE half precision, rounded to nearest even (from a float: the doubles are first rounded to
+// floats, whose 24 significant bits leave the double rounding harmless for 11)
+uint16_t toFloat16(float value)
+{
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    const int floatExponent = static_cast<int>((x >> 23) & 0xffu);
+    uint32_t mantissa = x & 0x7fffffu;
+    if (floatExponent == 0xff) // Infinity or NaN
+        return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+    const int exponent = floatExponent - 127 + 15;
+    if (exponent >= 31) // Overflow: infinity
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    if (exponent <= 0) { // Subnormal or zero
+        if (exponent < -10)
+            return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000u;
+        const int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1u)))
+            half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+        half++; // A carry into the exponent is still the right rounding (up to infinity)
+    return static_cast<uint16_t>(half);
+}
+
+float fromFloat16(uint16_t half)
+{
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    const int exponent = (half >> 10) & 0x1f;
+    const uint32_t mantissa = half & 0x3ffu;
+    if (exponent == 0) {
+        const float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+    const uint32_t x = exponent == 31 ? sign | 0x7f800000u | (mantissa << 13)
+                                      : sign | (static_cast<uint32_t>(exponent - 15 + 127) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+// The upper half of a float, rounded to nearest even
+uint16_t toBFloat16(float value)
+{
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+    if ((x & 0x7fffffffu) > 0x7f800000u) // NaN: keep it one
+        return static_cast<uint16_t>((x >> 16) | 0x40u);
+    x += 0x7fffu + ((x >> 16) & 1u);
+    return static_cast<uint16_t>(x >> 16);
+}
+
+float fromBFloat16(uint16_t half)
+{
+    const uint32_t x = static_cast<uint32_t>(half) << 16;
+    float value;
+    std::memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+template <uint16_t (*encode)(float), float (*decode)(uint16_t)>
+void sum16(void* in, void* inout, int* len, MPI_Datatype*)
+{
+    const uint16_t* a = static_cast<const uint16_t*>(in);
+    uint16_t* b = static_cast<uint16_t*>(inout);
+    for (int k = 0; k < *len; k++)
+        b[k] = encode(decode(a[k]) + decode(b[k]));
+}
+
+// Sum of 16-bit floats (of MPI_UINT16_T elements), created once and freed by MPI_Finalize
+MPI_Op sumOperator(CollectiveCompression::Kind kind)
+{
+    static MPI_Op float16Sum = MPI_OP_NULL, bfloat16Sum = MPI_OP_NULL;
+    MPI_Op& op = kind == CollectiveCompression::Kind::Float16 ? float16Sum : bfloat16Sum;
+    if (op == MPI_OP_NULL) {
+        MPI_Op_create(kind == CollectiveCompression::Kind::Float16 ? sum16<toFloat16, fromFloat16> : sum16<toBFloat16, fromBFloat16>,
+                      1, &op);
+        atFinalize([&op] { MPI_Op_free(&op); });
+    }
+    return op;
+}
+
+uint16_t encode16(CollectiveCompression::Kind kind, double value)
+{
+    return kind == CollectiveCompression::Kind::Float16 ? toFloat16(static_cast<float>(value))
+                                                        : toBFloat16(static_cast<float>(value));
+}
+
+double decode16(CollectiveCompression::Kind kind, uint16_t value)
+{
+    return kind == CollectiveCompression::Kind::Float16 ? fromFloat16(value) : fromBFloat16(value);
+}
+
+// An element of a top-k: what a process sends of it
+struct SparseElement
+{
+    int64_t index;
+    double value;
+};
+
+} // namespace
+
+CollectiveCompression::CollectiveCompression(Kind kind, double fraction, bool errorFeedback)
+    : kind(kind), fraction(fraction), errorFeedback(errorFeedback)
+{
+    if (kind == Kind::TopK && !(fraction > 0.0 && fraction <= 1.0))
+        throw std::invalid_argument("The fraction of a top-k must be in (0, 1]");
+}
+
+CollectiveCompression::Kind CollectiveCompression::getKind() const { return kind; }
+double CollectiveCompression::getFraction() const { return fraction; }
+
+void CollectiveCompression::allreduce(double* data, long count, MPI_Comm comm)
+{
+    MATRIX_ZONE("CollectiveCompression::allreduce");
+    if (kind == Kind::None) {
+        MPI_Allreduce(MPI_IN_PLACE, data, static_cast<int>(count), MPI_DOUBLE, MPI_SUM, comm);
+        return;
+    }
+    // The contribution of this process: its data plus what the last reduction could not send
+    if (errorFeedback) {
+        if (static_cast<long>(residual.size()) != count)
+            residual.assign(count, 0.0);
+        for (long k = 0; k < count; k++)
+            data[k] += residual[k];
+    }
+
+    if (kind == Kind::TopK) {
+        const long keep = std::min(count, std::max(1L, static_cast<long>(std::ceil(fraction * count))));
+        std::vector<int64_t> order(count);
+        for (long k = 0; k < count; k++)
+            order[k] = k;
+        std::nth_element(order.begin(), order.begin() + (keep - 1), order.end(),
+                         [data](int64_t a, int64_t b) { return std::fabs(data[a]) > std::fabs(data[b]); });
+        std::vector<SparseElement> sent(keep);
+        for (long k = 0; k < keep; k++)
+            sent[k] = {order[k], data[order[k]]};
+
+        int numProcs;
+        MPI_Comm_size(comm, &numProcs);
+        std::vector<SparseElement> received(static_cast<size_t>(keep) * numProcs);
+        const int bytes = static_cast<int>(keep * sizeof(SparseElement));
+        MPI_Allgather(sent.data(), bytes, MPI_BYTE, received.data(), bytes, MPI_BYTE, comm);
+
+        // What is left out waits for the next reduction
+        if (errorFeedback) {
+            std::copy(data, data + count, residual.begin());
+            for (const SparseElement& e : sent)
+                residual[e.index] = 0.0;
+        }
+        std::fill(data, data + count, 0.0);
+        for (const SparseElement& e : received)
+            data[e.index] += e.value;
+        return;
+    }
+
+    std::vector<uint16_t> packed(count);
+    for (long k = 0; k < count; k++) {
+        packed[k] = encode16(kind, data[k]);
+        if (errorFeedback)
+            residual[k] = data[k] - decode16(kind, packed[k]);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, packed.data(), static_cast<int>(count), MPI_UINT16_T, sumOperator(kind), comm);
+    for (long k = 0; k < count; k++)
+        data[k] = decode16(kind, packed[k]);
+}
+
+void CollectiveCompression::broadcast(double* data, long count, int root, MPI_Comm comm)
+{
+    MATRIX_ZONE("CollectiveCompression::broadcast");
+    if (kind == Kind::TopK)
+        throw std::invalid_argument("A top-k compression only applies to reductions");
+    if (kind == Kind::None) {
+        MPI_Bcast(data, static_cast<int>(count), MPI_DOUBLE, root, comm);
+        return;
+    }
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    std::vector<uint16_t> packed(count);
+    if (rank == root)
+        for (long k = 0; k < count; k++)
+            packed[k] = encode16(kind, data[k]);
+    MPI_Bcast(packed.data(), static_cast<int>(count), MPI_UINT16_T, root, comm);
+    for (long k = 0; k < count; k++)
+        data[k] = decode16(kind, packed[k]);
+}
+
+// --- NodeSharedMatrix ---
+
+struct NodeSharedMatrix::Window {
+    MPI_Win win = MPI_WIN_NULL;
+    MPI_Comm node = MPI_COMM_NULL;
+    double* data = nullptr;
+
+    ~Window()
+    {
+        int finalized;
+        MPI_Finalized(&finalized);
+        if (win != MPI_WIN_NULL && !finalized) {
+            MPI_Win_unlock_all(win);
+            MPI_Win_free(&win);
+        }
+    }
+
+    // Makes the writes of every process of the node visible to the others
+    void synchronize()
+    {
+        MPI_Win_sync(win);
+        MPI_Barrier(node);
+        MPI_Win_sync(win);
+    }
+};
+
+NodeSharedMatrix::NodeSharedMatrix(int rows, int cols, MPI_Comm comm)
+    : rows(rows), cols(cols), window(std::make_shared<Window>())
+{
+    // The first process of the node allocates the whole matrix, the others map it
+    window->node = nodeComms(comm).node;
+    int nodeRank;
+    MPI_Comm_rank(window->node, &nodeRank);
+    const MPI_Aint count = static_cast<MPI_Aint>(rows) * cols;
+    double* mine;
+    MPI_Win_allocate_shared(nodeRank == 0 ? count * static_cast<MPI_Aint>(sizeof(double)) : 0, sizeof(double),
+                            MPI_INFO_NULL, window->node, &mine, &window->win);
+    MPI_Aint size;
+    int unit;
+    MPI_Win_shared_query(window->win, 0, &size, &unit, &window->data);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window->win);
+    if (nodeRank == 0)
+        std::fill(window->data, window->data + count, 0.0);
+    window->synchronize();
+}
+
+NodeSharedMatrix::NodeSharedMatrix(const Matrix& matrix, int src, MPI_Comm comm)
+{
+    MATRIX_ZONE("NodeSharedMatrix");
+    int dims[2] = {matrix.numRows(), matrix.numCols()};
+    MPI_Bcast(dims, 2, MPI_INT, src, comm);
+    *this = NodeSharedMatrix(dims[0], dims[1], comm);
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == src)
+        std::copy(matrix.rawData(), matrix.rawData() + static_cast<size_t>(rows) * cols, window->data);
+    window->synchronize();
+    // The first process of the node of `src` broadcasts the matrix to those of the other nodes
+    const NodeComms& nodes = nodeComms(comm);
+    int root = nodes.leaderRank;
+    MPI_Bcast(&root, 1, MPI_INT, src, comm);
+    if (nodes.leaders != MPI_COMM_NULL)
+        MPI_Bcast(window->data, rows * cols, MPI_DOUBLE, root, nodes.leaders);
+    window->synchronize();
+}
+
+int NodeSharedMatrix::numRows() const { return rows; }
+int NodeSharedMatrix::numCols() const { return cols; }
+const double* NodeSharedMatrix::rawData() const { return window->data; }
+
+double NodeSharedMatrix::get(int i, int j) const
+{
+    if (i < 0 || i >= rows || j < 0 || j >= cols)
+        throw std::out_of_range("Matrix index out of range");
+    return window->data[static_cast<size_t>(i) * cols + j];
+}
+
+Matrix NodeSharedMatrix::toMatrix() const
+{
+    Matrix copy(rows, cols);
+    std::copy(window->data, window->data + static_cast<size_t>(rows) * cols, copy.rawData());
+    return copy;
+}
+
+// --- DistributedMatrix ---
 
 DistributedMatrix::DistributedMatrix(const Matrix& matrix, int numProcs)
+    : DistributedMatrix(matrix, numProcs, Layout::Columns)
+{
+}
+
+DistributedMatrix::DistributedMatrix(const Matrix& matrix, int numProcs, Layout layout, int blockSize, MPI_Comm comm)
     : globalRows(matrix.numRows()),
       globalCols(matrix.numCols()),
+      localRows(0),
       localCols(0),
-      startCol(0),
       numProcesses(numProcs),
       rank(0),
+      layout(layout),
       localData(matrix.numRows(), 1)
 {
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    distribute(blockSize, comm);
+    for (int i = 0; i < localRows; i++) {
+        int globalI = rowDist.toGlobal(grid->myRow, i);
+        for (int j = 0; j < localCols; j++)
+            localData.set(i, j, matrix.get(globalI, colDist.toGlobal(grid->myCol, j)));
+    }
+}
+
+DistributedMatrix::DistributedMatrix(const Matrix& matrix, int numProcs, const Partitioner& partitioner, MPI_Comm comm)
+    : DistributedMatrix(Matrix(matrix.numRows(), 0), numProcs, Layout::Columns, 64, comm)
+{
+    globalCols = matrix.numCols();
+    colDist = partitioned(globalCols, grid->cols, partitioner);
+    localCols = colDist.localSize(grid->myCol);
+    localData = Matrix(localRows, localCols);
+    const int first = colDist.toGlobal(grid->myCol, 0);
+    for (int i = 0; i < localRows; i++)
+        std::copy(matrix.rawData() + static_cast<size_t>(i) * globalCols + first,
+                  matrix.rawData() + static_cast<size_t>(i) * globalCols + first + localCols,
+                  localData.rawData() + static_cast<size_t>(i) * localCols);
+}
+
+DistributedMatrix::DistributedMatrix(const std::string& path, int numProcs, Layout layout, int blockSize, MPI_Comm comm)
+    : globalRows(0),
+      globalCols(0),
+      localRows(0),
+      localCols(0),
+      numProcesses(numProcs),
+      rank(0),
+      layout(layout),
+      localData(0, 0)
+{
+    MATRIX_ZONE("DistributedMatrix::DistributedMatrix(file)");
+    if (layout == Layout::BlockCyclic && blockSize <= 0)
+        throw std::invalid_argument("DistributedMatrix block size must be positive");
+    // The dimensions are only known from the header: Layout::Auto is resolved by distribute()
+    std::shared_ptr<const ProcessGrid> fileGrid =
+        layoutGrid(layout == Layout::Auto ? Layout::Columns : layout, numProcs, comm);
+    MPI_File file;
+    checkFileError(MPI_File_open(fileGrid->comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file), "open", path);
+
+    // Every process reads the header, so they all agree on the dimensions and on its validity
+    int64_t header[2] = {-1, -1};
+    MPI_Offset fileSize = 0;
+    int error = MPI_File_read_at_all(file, 0, header, 2, MPI_INT64_T, MPI_STATUS_IGNORE);
+    if (error == MPI_SUCCESS)
+        error = MPI_File_get_size(file, &fileSize);
+    if (error != MPI_SUCCESS) {
+        MPI_File_close(&file);
+        checkFileError(error, "read", path);
+    }
+    if (header[0] < 0 || header[1] < 0 || header[0] > INT32_MAX || header[1] > INT32_MAX ||
+        fileSize < fileHeaderBytes + static_cast<MPI_Offset>(header[0]) * header[1] * static_cast<MPI_Offset>(sizeof(double))) {
+        MPI_File_close(&file);
+        throw std::runtime_error("Not a matrix file (or truncated): " + path);
+    }
+    globalRows = static_cast<int>(header[0]);
+    globalCols = static_cast<int>(header[1]);
+    distribute(blockSize, comm);
+
+    // The file view of each process only shows its own elements, read by one collective call
+    MPI_Datatype block = localBlockType(*this), row = localRowType(*this);
+    error = MPI_File_set_view(file, fileHeaderBytes, MPI_DOUBLE, block, "native", MPI_INFO_NULL);
+    if (error == MPI_SUCCESS)
+        error = MPI_File_read_at_all(file, 0, localData.rawData(), localRows, row, MPI_STATUS_IGNORE);
+    MPI_Type_free(&block);
+    MPI_Type_free(&row);
+    MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, grid->comm);
+    MPI_File_close(&file);
+    checkFileError(error, "read", path);
+}
+
+void DistributedMatrix::distribute(int blockSize, MPI_Comm comm)
+{
+    if (layout == Layout::Auto)
+        layout = autoLayout(globalRows, globalCols, numProcesses, blockSize);
+    if (layout == Layout::BlockCyclic && blockSize <= 0)
+        throw std::invalid_argument("DistributedMatrix block size must be positive");
+    grid = layoutGrid(layout, numProcesses, comm);
+    MPI_Comm_rank(grid->comm, &rank);
+
+    int block = layout == Layout::BlockCyclic ? blockSize : 0;
+    rowDist = {globalRows, grid->rows, block, {}};
+    colDist = {globalCols, grid->cols, block, {}};
+    localRows = rowDist.localSize(grid->myRow);
+    localCols = colDist.localSize(grid->myCol);
+    localData = Matrix(localRows, localCols);
+}
+
+DistributedMatrix::DistributedMatrix(int rows, int cols, const DistributedMatrix& like)
+    : globalRows(rows),
+      globalCols(cols),
+      localRows(0),
+      localCols(0),
+      numProcesses(like.numProcesses),
+      rank(like.rank),
+      layout(like.layout),
+      rowDist(resized(like.rowDist, rows)),
+      colDist(resized(like.colDist, cols)),
+      grid(like.grid),
+      localData(0, 0)
+{
+    localRows = rowDist.localSize(grid->myRow);
+    localCols = colDist.localSize(grid->myCol);
+    localData = Matrix(localRows, localCols);
+}
 
-    // TODO
+DistributedMatrix::DistributedMatrix(const DistributedMatrix& like, Matrix&& local)
+    : globalRows(like.globalRows),
+      globalCols(like.globalCols),
+      localRows(like.localRows),
+      localCols(like.localCols),
+      numProcesses(like.numProcesses),
+      rank(like.rank),
+      layout(like.layout),
+      rowDist(like.rowDist),
+      colDist(like.colDist),
+      grid(like.grid),
+      localData(std::move(local))
+{
 }
 
 DistributedMatrix::DistributedMatrix(const DistributedMatrix& other)
     : globalRows(other.globalRows),
       globalCols(other.globalCols),
+      localRows(other.localRows),
       localCols(other.localCols),
-      startCol(other.startCol),
       numProcesses(other.numProcesses),
       rank(other.rank),
+      layout(other.layout),
+      rowDist(other.rowDist),
+      colDist(other.colDist),
+      grid(other.grid),
       localData(other.localData)
 {
 }
 
+DistributedMatrix::DistributedMatrix(DistributedMatrix&& other)
+    : globalRows(other.globalRows),
+      globalCols(other.globalCols),
+      localRows(other.localRows),
+      localCols(other.localCols),
+      numProcesses(other.numProcesses),
+      rank(other.rank),
+      layout(other.layout),
+      rowDist(other.rowDist),
+      colDist(other.colDist),
+      grid(other.grid),
+      localData(0, 0)
+{
+    if (other.remote)
+        throw std::logic_error("DistributedMatrix cannot be moved during remote access");
+    localData = std::move(other.localData);
+    other.localRows = other.localCols = 0;
+}
+
+DistributedMatrix& DistributedMatrix::operator=(const DistributedMatrix& other)
+{
+    if (remote)
+        throw std::logic_error("DistributedMatrix cannot be assigned during remote access");
+    globalRows = other.globalRows;
+    globalCols = other.globalCols;
+    localRows = other.localRows;
+    localCols = other.localCols;
+    numProcesses = other.numProcesses;
+    rank = other.rank;
+    layout = other.layout;
+    rowDist = other.rowDist;
+    colDist = other.colDist;
+    grid = other.grid;
+    localData = other.localData;
+    return *this;
+}
+
 int DistributedMatrix::numRows() const { return globalRows; }
 int DistributedMatrix::numCols() const { return globalCols; }
 const Matrix& DistributedMatrix::getLocalData() const { return localData; }
+DistributedMatrix::Layout DistributedMatrix::getLayout() const { return layout; }
+const ProcessGrid& DistributedMatrix::getGrid() const { return *grid; }
+const IndexDistribution& DistributedMatrix::getRowDistribution() const { return rowDist; }
+const IndexDistribution& DistributedMatrix::getColDistribution() const { return colDist; }
+
+// RMA window of a matrix during remote access (see beginRemoteAccess)
+struct DistributedMatrix::RemoteAccess {
+    MPI_Win win = MPI_WIN_NULL;
+
+    ~RemoteAccess()
+    {
+        int finalized;
+        MPI_Finalized(&finalized);
+        if (win != MPI_WIN_NULL && !finalized) {
+            MPI_Win_unlock_all(win);
+            MPI_Win_free(&win);
+        }
+    }
+};
 
 double DistributedMatrix::get(int i, int j) const
 {
-    // TODO
-    return 0.0;
+    int localI = localRowIndex(i);
+    int localJ = localColIndex(j);
+    if ((localI < 0 || localJ < 0) && remote) {
+        std::pair<int, MPI_Aint> location = remoteLocation(i, j);
+        double value;
+        MPI_Get(&value, 1, MPI_DOUBLE, location.first, location.second, 1, MPI_DOUBLE, remote->win);
+        MPI_Win_flush(location.first, remote->win);
+        return value;
+    }
+    if (localI < 0 || localJ < 0)
+        throw std::out_of_range("Element (" + std::to_string(i) + ", " + std::to_string(j) +
+                                ") is not owned by process " + std::to_string(rank));
+    return localData.get(localI, localJ);
 }
 
 void DistributedMatrix::set(int i, int j, double value)
 {
-    // TODO
+    int localI = localRowIndex(i);
+    int localJ = localColIndex(j);
+    if ((localI < 0 || localJ < 0) && remote) {
+        std::pair<int, MPI_Aint> location = remoteLocation(i, j);
+        MPI_Accumulate(&value, 1, MPI_DOUBLE, location.first, location.second, 1, MPI_DOUBLE, MPI_REPLACE,
+                       remote->win);
+        // `value` goes out of scope: the operation must complete locally first
+        MPI_Win_flush_local(location.first, remote->win);
+        return;
+    }
+    if (localI < 0 || localJ < 0)
+        throw std::out_of_range("Element (" + std::to_string(i) + ", " + std::to_string(j) +
+                                ") is not owned by process " + std::to_string(rank));
+    localData.set(localI, localJ, value);
+}
+
+// --- One-sided access ---
+
+namespace {
+
+// Elements of a batch owned by one process: distinct offsets in its local block, in
+// increasing order, and the position among them of every element of the batch
+struct OwnerBatch {
+    std::vector<int> offsets;
+    std::vector<std::pair<size_t, int>> elements; // (index in the batch, index in `offsets`)
+};
+
+std::map<int, OwnerBatch> batchByOwner(const std::vector<std::pair<int, MPI_Aint>>& locations)
+{
+    std::map<int, std::vector<std::pair<MPI_Aint, size_t>>> byOwner;
+    for (size_t e = 0; e < locations.size(); e++)
+        byOwner[locations[e].first].push_back({locations[e].second, e});
+    std::map<int, OwnerBatch> batches;
+    for (auto& entry : byOwner) {
+        std::vector<std::pair<MPI_Aint, size_t>>& items = entry.second;
+        std::sort(items.begin(), items.end());
+        OwnerBatch& batch = batches[entry.first];
+        // The target datatype of an RMA operation must not repeat an element
+        for (const auto& item : items) {
+            if (batch.offsets.empty() || batch.offsets.back() != item.first)
+                batch.offsets.push_back(static_cast<int>(item.first));
+            batch.elements.push_back({item.second, static_cast<int>(batch.offsets.size()) - 1});
+        }
+    }
+    return batches;
+}
+
+// The elements of `batch` in the local block of their owner
+MPI_Datatype batchType(const OwnerBatch& batch)
+{
+    MPI_Datatype type;
+    MPI_Type_create_indexed_block(static_cast<int>(batch.offsets.size()), 1, batch.offsets.data(), MPI_DOUBLE, &type);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+} // namespace
+
+std::pair<int, MPI_Aint> DistributedMatrix::remoteLocation(int i, int j) const
+{
+    if (i < 0 || i >= globalRows || j < 0 || j >= globalCols)
+        throw std::out_of_range("Element (" + std::to_string(i) + ", " + std::to_string(j) + ") is out of range");
+    const int ownerCol = colDist.owner(j);
+    return {rowDist.owner(i) * grid->cols + ownerCol,
+            static_cast<MPI_Aint>(rowDist.toLocal(i)) * colDist.localSize(ownerCol) + colDist.toLocal(j)};
+}
+
+void DistributedMatrix::beginRemoteAccess()
+{
+    MATRIX_ZONE("DistributedMatrix::beginRemoteAccess");
+    if (remote)
+        throw std::logic_error("DistributedMatrix remote access is already open");
+    auto access = std::make_shared<RemoteAccess>();
+    // A single process owns all the elements: no window needed
+    if (numProcesses > 1) {
+        MPI_Win_create(localData.rawData(), static_cast<MPI_Aint>(localRows) * localCols * sizeof(double),
+                       sizeof(double), MPI_INFO_NULL, grid->comm, &access->win);
+        MPI_Win_lock_all(0, access->win);
+    }
+    remote = access;
+}
+
+void DistributedMatrix::endRemoteAccess()
+{
+    MATRIX_ZONE("DistributedMatrix::endRemoteAccess");
+    if (!remote)
+        throw std::logic_error("DistributedMatrix remote access is not open");
+    // Completes the updates of this process; MPI_Win_free then waits for those of the others
+    if (remote->win != MPI_WIN_NULL) {
+        MPI_Win_flush_all(remote->win);
+        MPI_Win_unlock_all(remote->win);
+        MPI_Win_free(&remote->win);
+    }
+    remote.reset();
+}
+
+bool DistributedMatrix::inRemoteAccess() const
+{
+    return remote != nullptr;
+}
+
+void DistributedMatrix::accumulate(int i, int j, double value)
+{
+    accumulateMany({{i, j}}, {value});
+}
+
+std::vector<double> DistributedMatrix::getMany(const std::vector<std::pair<int, int>>& elements) const
+{
+    MATRIX_ZONE("DistributedMatrix::getMany");
+    // Local elements are read directly, the others in one batch per owner
+    std::vector<double> values(elements.size());
+    std::vector<std::pair<int, MPI_Aint>> locations;
+    std::vector<size_t> remoteElements;
+    for (size_t e = 0; e < elements.size(); e++) {
+        const int i = elements[e].first, j = elements[e].second;
+        if (!remote || (localRowIndex(i) >= 0 && localColIndex(j) >= 0)) {
+            values[e] = get(i, j);
+        } else {
+            locations.push_back(remoteLocation(i, j));
+            remoteElements.push_back(e);
+        }
+    }
+    if (locations.empty())
+        return values;
+    std::map<int, OwnerBatch> batches = batchByOwner(locations);
+    std::map<int, std::vector<double>> received;
+    std::vector<MPI_Datatype> types;
+    for (const auto& entry : batches) {
+        std::vector<double>& buffer = received[entry.first];
+        buffer.resize(entry.second.offsets.size());
+        types.push_back(batchType(entry.second));
+        MPI_Get(buffer.data(), static_cast<int>(buffer.size()), MPI_DOUBLE, entry.first, 0, 1, types.back(),
+                remote->win);
+    }
+    MPI_Win_flush_all(remote->win);
+    for (MPI_Datatype& type : types)
+        MPI_Type_free(&type);
+    for (const auto& entry : batches)
+        for (const auto& element : entry.second.elements)
+            values[remoteElements[element.first]] = received[entry.first][element.second];
+    return values;
+}
+
+void DistributedMatrix::accumulateMany(const std::vector<std::pair<int, int>>& elements,
+                                       const std::vector<double>& values)
+{
+    MATRIX_ZONE("DistributedMatrix::accumulateMany");
+    if (elements.size() != values.size())
+        throw std::invalid_argument("accumulateMany needs one value per element");
+    if (!remote || remote->win == MPI_WIN_NULL) {
+        for (size_t e = 0; e < elements.size(); e++)
+            set(elements[e].first, elements[e].second, get(elements[e].first, elements[e].second) + values[e]);
+        return;
+    }
+    std::vector<std::pair<int, MPI_Aint>> locations;
+    for (const auto& element : elements)
+        locations.push_back(remoteLocation(element.first, element.second));
+    // Values for the same element are summed before being sent
+    for (const auto& entry : batchByOwner(locations)) {
+        std::vector<double> sums(entry.second.offsets.size(), 0.0);
+        for (const auto& element : entry.second.elements)
+            sums[element.second] += values[element.first];
+        MPI_Datatype type = batchType(entry.second);
+        MPI_Accumulate(sums.data(), static_cast<int>(sums.size()), MPI_DOUBLE, entry.first, 0, 1, type, MPI_SUM,
+                       remote->win);
+        MPI_Type_free(&type);
+        // The origin buffer is reused once the operation completes locally
+        MPI_Win_flush_local(entry.first, remote->win);
+    }
+}
+
+void DistributedMatrix::flush()
+{
+    MATRIX_ZONE("DistributedMatrix::flush");
+    if (!remote || remote->win == MPI_WIN_NULL)
+        return;
+    MPI_Win_flush_all(remote->win);
+    MPI_Win_sync(remote->win);
 }
 
 int DistributedMatrix::globalColIndex(int localColIdx) const
 {
-    // TODO
-    return -1;
+    if (localColIdx < 0 || localColIdx >= localCols)
+        return -1;
+    return colDist.toGlobal(grid->myCol, localColIdx);
 }
 
 int DistributedMatrix::localColIndex(int globalColIdx) const
 {
-    // TODO
-    return -1;
+    if (globalColIdx < 0 || globalColIdx >= globalCols || colDist.owner(globalColIdx) != grid->myCol)
+        return -1;
+    return colDist.toLocal(globalColIdx);
 }
 
 int DistributedMatrix::ownerProcess(int globalColIdx) const
 {
-    // TODO
-    return -1;
+    if (globalColIdx < 0 || globalColIdx >= globalCols)
+        return -1;
+    return grid->myRow * grid->cols + colDist.owner(globalColIdx);
+}
+
+int DistributedMatrix::globalRowIndex(int localRowIdx) const
+{
+    if (localRowIdx < 0 || localRowIdx >= localRows)
+        return -1;
+    return rowDist.toGlobal(grid->myRow, localRowIdx);
+}
+
+int DistributedMatrix::localRowIndex(int globalRowIdx) const
+{
+    if (globalRowIdx < 0 || globalRowIdx >= globalRows || rowDist.owner(globalRowIdx) != grid->myRow)
+        return -1;
+    return rowDist.toLocal(globalRowIdx);
+}
+
+int DistributedMatrix::ownerProcess(int globalRowIdx, int globalColIdx) const
+{
+    if (globalRowIdx < 0 || globalRowIdx >= globalRows || globalColIdx < 0 || globalColIdx >= globalCols)
+        return -1;
+    return rowDist.owner(globalRowIdx) * grid->cols + colDist.owner(globalColIdx);
 }
 
 void DistributedMatrix::fill(double value)
 {
-    // TODO
+    MATRIX_ZONE("DistributedMatrix::fill");
+    localData.fill(value);
 }
 
 DistributedMatrix DistributedMatrix::operator+(const DistributedMatrix& other) const
 {
-    // TODO
-    return DistributedMatrix(*this);
+    MATRIX_ZONE("DistributedMatrix::operator+");
+    checkSamePartitioning(*this, other, "addition");
+    return DistributedMatrix(*this, localData + other.localData);
 }
 
 DistributedMatrix DistributedMatrix::operator-(const DistributedMatrix& other) const
 {
-    // TODO
-    return DistributedMatrix(*this);
+    MATRIX_ZONE("DistributedMatrix::operator-");
+    checkSamePartitioning(*this, other, "subtraction");
+    return DistributedMatrix(*this, localData - other.localData);
 }
 
 DistributedMatrix DistributedMatrix::operator*(double scalar) const
 {
-    // TODO
-    return DistributedMatrix(*this);
+    MATRIX_ZONE("DistributedMatrix::operator*");
+    return DistributedMatrix(*this, localData * scalar);
+}
+
+namespace {
+
+// End (excluded) of the block of `dist` containing the global index `k`, where consecutive
+// blocks of a single process count as one
+int blockEnd(const IndexDistribution& dist, int k)
+{
+    if (dist.procs == 1)
+        return dist.n;
+    if (dist.block != 0)
+        return std::min(dist.n, (k / dist.block + 1) * dist.block);
+    int p = dist.owner(k);
+    return dist.toGlobal(p, 0) + dist.localSize(p);
+}
+
+// Width of the SUMMA panels: wide enough for an efficient local GEMM, narrow enough for
+// the broadcast of the next panel to overlap with the product of the current one
+const int summaPanelWidth = 256;
+
+} // namespace
+
+DistributedMatrix DistributedMatrix::operator*(const DistributedMatrix& other) const
+{
+    MATRIX_ZONE("DistributedMatrix::operator*(DistributedMatrix)");
+    if (globalCols != other.globalRows)
+        throw std::invalid_argument("DistributedMatrix dimensions are incompatible for multiplication");
+    if (grid->comm != other.grid->comm)
+        throw std::invalid_argument("DistributedMatrix operands must live on the same process grid");
+
+    DistributedMatrix result(globalRows, other.globalCols, *this);
+    result.colDist = other.colDist;
+    result.localCols = result.colDist.localSize(grid->myCol);
+    result.localData = Matrix(result.localRows, result.localCols);
+
+    // The inner dimension is cut in panels that lie in a single column block of this matrix
+    // and a single row block of `other`. For each panel k, its owners broadcast A(:, k) along
+    // their grid row and B(k, :) along their grid column, then C += A(:, k) * B(k, :).
+    struct Panel {
+        int begin, width, ownerCol, ownerRow;
+    };
+    std::vector<Panel> panels;
+    for (int k = 0; k < globalCols;) {
+        int end = std::min({blockEnd(colDist, k), blockEnd(other.rowDist, k), k + summaPanelWidth});
+        panels.push_back({k, end - k, colDist.owner(k), other.rowDist.owner(k)});
+        k = end;
+    }
+
+    // Double buffering: the broadcasts of panel t + 1 progress while panel t is multiplied
+    Matrix aPanels[2] = {Matrix(0, 0), Matrix(0, 0)};
+    Matrix bPanels[2] = {Matrix(0, 0), Matrix(0, 0)};
+    MPI_Request requests[2][2];
+    auto start = [&](size_t t) {
+        const Panel& panel = panels[t];
+        Matrix& a = aPanels[t % 2];
+        Matrix& b = bPanels[t % 2];
+        a = Matrix(localRows, panel.width);
+        b = Matrix(panel.width, other.localCols);
+        if (grid->myCol == panel.ownerCol) {
+            int first = colDist.toLocal(panel.begin);
+            for (int i = 0; i < localRows; i++)
+                std::copy(localData.rawData() + static_cast<size_t>(i) * localCols + first,
+                          localData.rawData() + static_cast<size_t>(i) * localCols + first + panel.width,
+                          a.rawData() + static_cast<size_t>(i) * panel.width);
+        }
+        if (grid->myRow == panel.ownerRow) {
+            const double* rows = other.localData.rawData() +
+                                 static_cast<size_t>(other.rowDist.toLocal(panel.begin)) * other.localCols;
+            std::copy(rows, rows + static_cast<size_t>(panel.width) * other.localCols, b.rawData());
+        }
+        MPI_Ibcast(a.rawData(), localRows * panel.width, MPI_DOUBLE, panel.ownerCol, grid->rowComm, &requests[t % 2][0]);
+        MPI_Ibcast(b.rawData(), panel.width * other.localCols, MPI_DOUBLE, panel.ownerRow, grid->colComm,
+                   &requests[t % 2][1]);
+    };
+
+    if (!panels.empty())
+        start(0);
+    for (size_t t = 0; t < panels.size(); t++) {
+        if (t + 1 < panels.size())
+            start(t + 1);
+        MPI_Waitall(2, requests[t % 2], MPI_STATUSES_IGNORE);
+        // Accumulated in place into the (zero) result, without a temporary product per panel
+        Matrix::multiplyAdd(localRows, other.localCols, panels[t].width, aPanels[t % 2].rawData(),
+                            bPanels[t % 2].rawData(), result.localData.rawData());
+    }
+    return result;
 }
 
 Matrix DistributedMatrix::transpose() const
 {
-    // TODO
-    return Matrix(globalCols, globalRows);
+    MATRIX_ZONE("DistributedMatrix::transpose");
+    Matrix full(globalCols, globalRows);
+    gatherInto(*this, full.rawData(), true);
+    return full;
 }
 
 void DistributedMatrix::sub_mul(double scalar, const DistributedMatrix& other)
 {
-    // TODO
+    MATRIX_ZONE("DistributedMatrix::sub_mul");
+    checkSamePartitioning(*this, other, "sub_mul");
+    localData.sub_mul(scalar, other.localData);
 }
 
 DistributedMatrix DistributedMatrix::apply(const std::function<double(double)>& func) const
 {
-    // TODO
-    return DistributedMatrix(*this);
+    MATRIX_ZONE("DistributedMatrix::apply");
+    return DistributedMatrix(*this, localData.apply(func));
 }
 
 DistributedMatrix DistributedMatrix::applyBinary(
@@ -110,35 +1690,861 @@ DistributedMatrix DistributedMatrix::applyBinary(
     const DistributedMatrix& b,
     const std::function<double(double, double)>& func)
 {
-    // TODO
-    return DistributedMatrix(a);
+    MATRIX_ZONE("DistributedMatrix::applyBinary");
+    checkSamePartitioning(a, b, "applyBinary");
+    DistributedMatrix result(a.globalRows, a.globalCols, a);
+    const double* x = a.localData.rawData();
+    const double* y = b.localData.rawData();
+    double* z = result.localData.rawData();
+    const long n = static_cast<long>(a.localRows) * a.localCols;
+    for (long k = 0; k < n; k++)
+        z[k] = func(x[k], y[k]);
+    return result;
+}
+
+void DistributedMatrix::requireSamePartitioning(const DistributedMatrix& other, const char* op) const
+{
+    checkSamePartitioning(*this, other, op);
+}
+
+void DistributedMatrix::axpby(double alpha, const DistributedMatrix& x, double beta)
+{
+    axpby(alpha, x, beta, [](double value) { return value; });
 }
 
 DistributedMatrix multiply(const Matrix& left, const DistributedMatrix& right)
 {
-    // TODO
-    return DistributedMatrix(right);
+    MATRIX_ZONE("multiply");
+    if (left.numCols() != right.globalRows)
+        throw std::invalid_argument("Matrix dimensions are incompatible for multiplication");
+    return DistributedMatrix::multiplyLeft(left.rawData(), left.numRows(), left.numCols(), right);
+}
+
+DistributedMatrix multiply(const NodeSharedMatrix& left, const DistributedMatrix& right)
+{
+    MATRIX_ZONE("multiply(NodeSharedMatrix)");
+    if (left.numCols() != right.globalRows)
+        throw std::invalid_argument("Matrix dimensions are incompatible for multiplication");
+    return DistributedMatrix::multiplyLeft(left.rawData(), left.numRows(), left.numCols(), right);
+}
+
+DistributedMatrix DistributedMatrix::multiplyLeft(const double* left, int leftRows, int leftCols,
+                                                  const DistributedMatrix& right)
+{
+    // Column j of `left * right` only depends on column j of `right`,
+    // so with the column layout every process computes its own columns without communication.
+    DistributedMatrix result(leftRows, right.globalCols, right);
+    const ProcessGrid& grid = *right.grid;
+    if (grid.rows == 1) {
+        Matrix::multiplyAdd(leftRows, right.localCols, leftCols, left, right.localData.rawData(),
+                            result.localData.rawData());
+        return result;
+    }
+
+    // Otherwise, each process of a grid column holds some rows of the column block of `right`:
+    // multiply them by the matching columns of `left` and sum the partial products over the
+    // grid column, then keep the rows of the result owned by this process.
+    Matrix leftColumns(leftRows, right.localRows);
+    for (int i = 0; i < leftRows; i++)
+        for (int k = 0; k < right.localRows; k++)
+            leftColumns.set(i, k, left[static_cast<size_t>(i) * leftCols + right.globalRowIndex(k)]);
+    Matrix partial = leftColumns * right.localData;
+    MPI_Allreduce(MPI_IN_PLACE, partial.rawData(), leftRows * right.localCols,
+                  MPI_DOUBLE, MPI_SUM, grid.colComm);
+    for (int i = 0; i < result.localRows; i++) {
+        const double* row = partial.rawData() + static_cast<size_t>(result.globalRowIndex(i)) * right.localCols;
+        std::copy(row, row + right.localCols, result.localData.rawData() + static_cast<size_t>(i) * right.localCols);
+    }
+    return result;
+}
+
+namespace {
+
+// Transpose of the whole column block of `matrix` owned by this process's grid column:
+// with a 2D grid, its rows are first gathered from the processes of the grid column.
+Matrix transposedColumnBlock(const DistributedMatrix& matrix)
+{
+    const ProcessGrid& grid = matrix.getGrid();
+    const Matrix& local = matrix.getLocalData();
+    if (grid.rows == 1)
+        return local.transpose();
+
+    const IndexDistribution& rowDist = matrix.getRowDistribution();
+    const int cols = local.numCols();
+    std::vector<int> counts(grid.rows), displs(grid.rows);
+    for (int q = 0; q < grid.rows; q++) {
+        counts[q] = rowDist.localSize(q) * cols;
+        displs[q] = q == 0 ? 0 : displs[q - 1] + counts[q - 1];
+    }
+    std::vector<double> blocks(static_cast<size_t>(matrix.numRows()) * cols);
+    MPI_Allgatherv(local.rawData(), counts[grid.myRow], MPI_DOUBLE,
+                   blocks.data(), counts.data(), displs.data(), MPI_DOUBLE, grid.colComm);
+    Matrix blockT(cols, matrix.numRows());
+    for (int q = 0; q < grid.rows; q++)
+        for (int l = 0; l < rowDist.localSize(q); l++) {
+            int globalI = rowDist.toGlobal(q, l);
+            for (int j = 0; j < cols; j++)
+                blockT.set(j, globalI, blocks[displs[q] + static_cast<size_t>(l) * cols + j]);
+        }
+    return blockT;
+}
+
+// The result of multiplyTransposed is reduced in (up to) this many row blocks, so that the
+// reduction of a block overlaps with the computation of the next ones. Blocks have at least
+// `minReduceBlock` elements so that small results are reduced in one call.
+const int overlapBlocks = 8;
+const long minReduceBlock = 32768;
+
+} // namespace
+
+NodeSharedMatrix DistributedMatrix::multiplyTransposedShared(const DistributedMatrix& other) const
+{
+    MATRIX_ZONE("DistributedMatrix::multiplyTransposedShared");
+    if (globalCols != other.globalCols || !(colDist == other.colDist) || grid->comm != other.grid->comm)
+        throw std::invalid_argument("DistributedMatrix column partitionings must match for multiplyTransposedShared");
+    const int resultCols = other.globalRows;
+    Matrix partial = localData * transposedColumnBlock(other);
+    NodeSharedMatrix result(globalRows, resultCols, grid->comm);
+    NodeSharedMatrix::Window& window = *result.window;
+
+    // Reduction in shared memory: the rows of the result are cut in one slice per process of
+    // the node and, at step t, process r adds its rows of slice (r + t) % size, so that each
+    // slice is updated by a single process at a time and all of them work at every step.
+    const NodeComms& nodes = nodeComms(grid->comm);
+    int nodeRank, nodeSize;
+    MPI_Comm_rank(nodes.node, &nodeRank);
+    MPI_Comm_size(nodes.node, &nodeSize);
+    for (int t = 0; t < nodeSize; t++) {
+        const int slice = (nodeRank + t) % nodeSize;
+        const int begin = static_cast<int>(static_cast<long>(globalRows) * slice / nodeSize);
+        const int end = static_cast<int>(static_cast<long>(globalRows) * (slice + 1) / nodeSize);
+        for (int i = 0; i < localRows; i++) {
+            const int globalI = globalRowIndex(i);
+            if (globalI < begin || globalI >= end)
+                continue;
+            const double* row = partial.rawData() + static_cast<size_t>(i) * resultCols;
+            double* out = window.data + static_cast<size_t>(globalI) * resultCols;
+            std::transform(row, row + resultCols, out, out, std::plus<double>());
+        }
+        window.synchronize();
+    }
+    // Then across the nodes, by the first process of each
+    if (nodes.leaders != MPI_COMM_NULL)
+        MPI_Allreduce(MPI_IN_PLACE, window.data, globalRows * resultCols, MPI_DOUBLE, MPI_SUM, nodes.leaders);
+    window.synchronize();
+    return result;
 }
 
 Matrix DistributedMatrix::multiplyTransposed(const DistributedMatrix& other) const
 {
-    // TODO
-    return Matrix(globalRows, other.globalRows);
+    MATRIX_ZONE("DistributedMatrix::multiplyTransposed");
+    if (globalCols != other.globalCols || !(colDist == other.colDist) || grid->comm != other.grid->comm)
+        throw std::invalid_argument("DistributedMatrix column partitionings must match for multiplyTransposed");
+    const int resultCols = other.globalRows;
+
+    // A * B^T = sum over the column blocks p of A_p * B_p^T
+    Matrix otherBlockT = transposedColumnBlock(other);
+
+    // The rows of the result are computed by blocks; as soon as a block is computed, its
+    // reduction starts (MPI_Iallreduce) while the next block is computed. All the processes
+    // use the same blocks of global rows, and contribute those of their local rows in them.
+    Matrix result(globalRows, resultCols);
+    const int blockRows = static_cast<int>(std::max<long>(
+        {1, (globalRows + overlapBlocks - 1) / overlapBlocks, minReduceBlock / std::max(1, resultCols)}));
+    std::vector<MPI_Request> requests;
+    int local = 0; // First local row not computed yet
+    for (int begin = 0; begin < globalRows; begin += blockRows) {
+        const int end = std::min(globalRows, begin + blockRows);
+        const int first = local;
+        while (local < localRows && globalRowIndex(local) < end)
+            local++;
+        if (local > first && rowDist.block == 0) {
+            // Contiguous rows (column and row layouts): accumulated in place into the (zero) result
+            Matrix::multiplyAdd(local - first, resultCols, localCols,
+                                localData.rawData() + static_cast<size_t>(first) * localCols, otherBlockT.rawData(),
+                                result.rawData() + static_cast<size_t>(globalRowIndex(first)) * resultCols);
+        } else if (local > first) {
+            // Rows dealt round-robin (Layout::BlockCyclic): computed together, then scattered
+            Matrix rows(local - first, localCols);
+            std::copy(localData.rawData() + static_cast<size_t>(first) * localCols,
+                      localData.rawData() + static_cast<size_t>(local) * localCols, rows.rawData());
+            Matrix partial = rows * otherBlockT;
+            for (int i = first; i < local; i++) {
+                const double* row = partial.rawData() + static_cast<size_t>(i - first) * resultCols;
+                std::copy(row, row + resultCols, result.rawData() + static_cast<size_t>(globalRowIndex(i)) * resultCols);
+            }
+        }
+        requests.emplace_back();
+        MPI_Iallreduce(MPI_IN_PLACE, result.rawData() + static_cast<size_t>(begin) * resultCols,
+                       (end - begin) * resultCols, MPI_DOUBLE, MPI_SUM, grid->comm, &requests.back());
+        // Let MPI progress the pending reductions before computing the next block
+        int done;
+        MPI_Testall(static_cast<int>(requests.size()), requests.data(), &done, MPI_STATUSES_IGNORE);
+    }
+    MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+    return result;
+}
+
+Matrix DistributedMatrix::multiplyTransposed(const DistributedMatrix& other, CollectiveCompression& compression) const
+{
+    MATRIX_ZONE("DistributedMatrix::multiplyTransposed(compressed)");
+    if (globalCols != other.globalCols || !(colDist == other.colDist) || grid->comm != other.grid->comm)
+        throw std::invalid_argument("DistributedMatrix column partitionings must match for multiplyTransposed");
+    const int resultCols = other.globalRows;
+
+    // The contribution of every process to the whole result, then a single compressed
+    // reduction (the sparsification of a top-k needs all the elements at once)
+    Matrix partial = localData * transposedColumnBlock(other);
+    Matrix result(globalRows, resultCols);
+    result.fill(0.0);
+    for (int i = 0; i < localRows; i++) {
+        const double* row = partial.rawData() + static_cast<size_t>(i) * resultCols;
+        std::copy(row, row + resultCols, result.rawData() + static_cast<size_t>(globalRowIndex(i)) * resultCols);
+    }
+    compression.allreduce(result.rawData(), static_cast<long>(globalRows) * resultCols, grid->comm);
+    return result;
+}
+
+DistributedMatrix DistributedMatrix::multiplyTransposedDistributed(const DistributedMatrix& other) const
+{
+    MATRIX_ZONE("DistributedMatrix::multiplyTransposedDistributed");
+    if (globalCols != other.globalCols || !(colDist == other.colDist) || grid->comm != other.grid->comm)
+        throw std::invalid_argument("DistributedMatrix column partitionings must match for multiplyTransposedDistributed");
+    DistributedMatrix result(globalRows, other.globalRows, *this);
+
+    // The rows of A * B^T are distributed like the rows of A, so the rows computed by this
+    // process are those owned by its grid row: they only need to be summed over the grid row,
+    // and each process of the grid row receives the sum of its own columns.
+    Matrix partial = localData * transposedColumnBlock(other);
+    const IndexDistribution& resultCols = result.colDist;
+    std::vector<int> counts(grid->cols);
+    std::vector<double> packed(static_cast<size_t>(localRows) * result.globalCols);
+    double* out = packed.data();
+    for (int q = 0; q < grid->cols; q++) {
+        counts[q] = localRows * resultCols.localSize(q);
+        const int size = resultCols.localSize(q);
+        for (int i = 0; i < localRows; i++) {
+            const double* row = partial.rawData() + static_cast<size_t>(i) * result.globalCols;
+            // The local columns of q are runs of consecutive global columns (one block each)
+            for (int l = 0; l < size;) {
+                int run = resultCols.block == 0 ? size : std::min(size - l, resultCols.block - l % resultCols.block);
+                const double* first = row + resultCols.toGlobal(q, l);
+                out = std::copy(first, first + run, out);
+                l += run;
+            }
+        }
+    }
+    MPI_Reduce_scatter(packed.data(), result.localData.rawData(), counts.data(), MPI_DOUBLE, MPI_SUM, grid->rowComm);
+    return result;
+}
+
+namespace {
+
+// Thin QR factorization a = q * r of an m x n matrix (Householder reflections): q is m x n with
+// orthonormal columns and r is n x n upper triangular. If m < n, the last n - m columns of q
+// and rows of r are zero.
+void householderQR(const Matrix& a, Matrix& q, Matrix& r)
+{
+    const int m = a.numRows(), n = a.numCols(), k = std::min(m, n);
+    Matrix work(a);
+    double* w = work.rawData();
+    // Reflector j is I - 2 v v^T / (v^T v), v being zero above row j
+    std::vector<std::vector<double>> reflectors(k);
+    for (int j = 0; j < k; j++) {
+        std::vector<double>& v = reflectors[j];
+        v.resize(m - j);
+        double norm = 0.0;
+        for (int i = j; i < m; i++) {
+            v[i - j] = w[static_cast<size_t>(i) * n + j];
+            norm += v[i - j] * v[i - j];
+        }
+        norm = std::sqrt(norm);
+        // Reflect onto -sign(x0) |x| e0, which avoids the cancellation in x0 - alpha
+        v[0] += v[0] >= 0.0 ? norm : -norm;
+        double vNorm2 = 0.0;
+        for (double x : v)
+            vNorm2 += x * x;
+        if (vNorm2 == 0.0) {
+            v.clear(); // Zero column: nothing to reflect
+            continue;
+        }
+        for (int c = j; c < n; c++) {
+            double dot = 0.0;
+            for (int i = j; i < m; i++)
+                dot += v[i - j] * w[static_cast<size_t>(i) * n + c];
+            dot *= 2.0 / vNorm2;
+            for (int i = j; i < m; i++)
+                w[static_cast<size_t>(i) * n + c] -= dot * v[i - j];
+        }
+    }
+
+    r = Matrix(n, n);
+    for (int i = 0; i < k; i++)
+        for (int c = i; c < n; c++)
+            r.set(i, c, w[static_cast<size_t>(i) * n + c]);
+    // q = H_0 ... H_{k-1} applied to the first k columns of the identity
+    q = Matrix(m, n);
+    double* qData = q.rawData();
+    for (int i = 0; i < k; i++)
+        qData[static_cast<size_t>(i) * n + i] = 1.0;
+    for (int j = k - 1; j >= 0; j--) {
+        const std::vector<double>& v = reflectors[j];
+        if (v.empty())
+            continue;
+        double vNorm2 = 0.0;
+        for (double x : v)
+            vNorm2 += x * x;
+        for (int c = j; c < k; c++) {
+            double dot = 0.0;
+            for (int i = j; i < m; i++)
+                dot += v[i - j] * qData[static_cast<size_t>(i) * n + c];
+            dot *= 2.0 / vNorm2;
+            for (int i = j; i < m; i++)
+                qData[static_cast<size_t>(i) * n + c] -= dot * v[i - j];
+        }
+    }
+}
+
+// Rows [first, first + count) of `matrix`
+Matrix rowRange(const Matrix& matrix, int first, int count)
+{
+    Matrix rows(count, matrix.numCols());
+    const double* begin = matrix.rawData() + static_cast<size_t>(first) * matrix.numCols();
+    std::copy(begin, begin + static_cast<size_t>(count) * matrix.numCols(), rows.rawData());
+    return rows;
+}
+
+} // namespace
+
+std::pair<DistributedMatrix, Matrix> DistributedMatrix::tsqr() const
+{
+    MATRIX_ZONE("DistributedMatrix::tsqr");
+    if (grid->cols != 1)
+        throw std::invalid_argument("DistributedMatrix::tsqr requires whole rows on every process (Layout::Rows)");
+    const int n = globalCols;
+    const int numProcs = grid->rows;
+    const int me = grid->myRow; // Rank in the grid, which is P x 1
+    Matrix localQ(0, 0), r(0, 0);
+    householderQR(localData, localQ, r);
+
+    // Up the tree: at level `step`, process p (a multiple of 2 step) stacks its R over that of
+    // p + step and factors them again, keeping the Q of the pair for the way down.
+    struct Merge {
+        int step;
+        Matrix q;
+    };
+    std::vector<Merge> merges;
+    int step = 1;
+    for (; step < numProcs; step *= 2) {
+        if (me % (2 * step) != 0) {
+            MPI_Send(r.rawData(), n * n, MPI_DOUBLE, me - step, step, grid->comm);
+            break;
+        }
+        if (me + step >= numProcs)
+            continue;
+        Matrix stacked(2 * n, n);
+        std::copy(r.rawData(), r.rawData() + static_cast<size_t>(n) * n, stacked.rawData());
+        MPI_Recv(stacked.rawData() + static_cast<size_t>(n) * n, n * n, MPI_DOUBLE, me + step, step, grid->comm,
+                 MPI_STATUS_IGNORE);
+        Matrix pairQ(0, 0);
+        householderQR(stacked, pairQ, r);
+        merges.push_back({step, pairQ});
+    }
+
+    // The root makes the diagonal of R non-negative (R = D R, Q = Q D with D = diag(+-1)), which
+    // makes the factorization unique, then R goes to every process
+    Matrix c(n, n); // Factor of the Q of the subtree of this process in the final Q
+    if (me == 0) {
+        for (int i = 0; i < n; i++) {
+            const double sign = r.get(i, i) < 0.0 ? -1.0 : 1.0;
+            c.set(i, i, sign);
+            for (int j = i; j < n; j++)
+                r.set(i, j, sign * r.get(i, j));
+        }
+    } else {
+        MPI_Recv(c.rawData(), n * n, MPI_DOUBLE, me - step, step, grid->comm, MPI_STATUS_IGNORE);
+    }
+    if (me != 0)
+        r = Matrix(n, n);
+    MPI_Bcast(r.rawData(), n * n, MPI_DOUBLE, 0, grid->comm);
+
+    // Down the tree: the Q of a pair times the factor of the pair gives the factors of both halves
+    for (auto merge = merges.rbegin(); merge != merges.rend(); ++merge) {
+        Matrix both = merge->q * c;
+        c = rowRange(both, 0, n);
+        Matrix partner = rowRange(both, n, n);
+        MPI_Send(partner.rawData(), n * n, MPI_DOUBLE, me + merge->step, merge->step, grid->comm);
+    }
+
+    // Q is distributed like this matrix, around the product (no copy of the local block)
+    return {DistributedMatrix(*this, localQ * c), std::move(r)};
 }
 
 double DistributedMatrix::sum() const
 {
-    // TODO
-    return 0.0;
+    MATRIX_ZONE("DistributedMatrix::sum");
+    return allreduceSum(localData.sum(), grid->comm);
 }
 
 Matrix DistributedMatrix::gather() const
 {
-    // TODO
-    return Matrix(globalRows, globalCols);
+    MATRIX_ZONE("DistributedMatrix::gather");
+    Matrix full(globalRows, globalCols);
+    gatherInto(*this, full.rawData(), false);
+    return full;
 }
 
-void sync_matrix(Matrix *matrix, int rank, int src)
+void DistributedMatrix::repartition(const Partitioner& partitioner)
+{
+    MATRIX_ZONE("DistributedMatrix::repartition");
+    if (remote)
+        throw std::logic_error("DistributedMatrix cannot be repartitioned during remote access");
+    if (layout != Layout::Columns)
+        throw std::invalid_argument("DistributedMatrix::repartition requires the column layout");
+    IndexDistribution newDist = partitioned(globalCols, grid->cols, partitioner);
+    if (newDist == colDist)
+        return;
+    Matrix newData(localRows, newDist.localSize(rank));
+
+    // Process p sends to q the columns in both its old part and the new part of q, described
+    // by a vector type (a segment of every row) on both sides: no packing
+    auto overlapType = [&](int begin, int end, int first, int ld, int& count, int& displ) {
+        MPI_Datatype type = MPI_DOUBLE;
+        count = 0;
+        displ = 0;
+        if (end > begin && localRows > 0) {
+            MPI_Type_vector(localRows, end - begin, ld, MPI_DOUBLE, &type);
+            MPI_Type_commit(&type);
+            count = 1;
+            displ = static_cast<int>((begin - first) * sizeof(double));
+        }
+        return type;
+    };
+    const int first = colDist.toGlobal(rank, 0), newFirst = newDist.toGlobal(rank, 0);
+    const int last = first + localCols, newLast = newFirst + newData.numCols();
+    std::vector<int> sendCounts(numProcesses), sendDispls(numProcesses), recvCounts(numProcesses), recvDispls(numProcesses);
+    std::vector<MPI_Datatype> sendTypes(numProcesses), recvTypes(numProcesses);
+    for (int q = 0; q < numProcesses; q++) {
+        int qFirst = newDist.toGlobal(q, 0), qOldFirst = colDist.toGlobal(q, 0);
+        sendTypes[q] = overlapType(std::max(first, qFirst), std::min(last, qFirst + newDist.localSize(q)), first,
+                                   localCols, sendCounts[q], sendDispls[q]);
+        recvTypes[q] = overlapType(std::max(newFirst, qOldFirst), std::min(newLast, qOldFirst + colDist.localSize(q)),
+                                   newFirst, newData.numCols(), recvCounts[q], recvDispls[q]);
+    }
+    MPI_Alltoallw(localData.rawData(), sendCounts.data(), sendDispls.data(), sendTypes.data(), newData.rawData(),
+                  recvCounts.data(), recvDispls.data(), recvTypes.data(), grid->comm);
+    for (int q = 0; q < numProcesses; q++) {
+        if (sendCounts[q] > 0)
+            MPI_Type_free(&sendTypes[q]);
+        if (recvCounts[q] > 0)
+            MPI_Type_free(&recvTypes[q]);
+    }
+
+    colDist = newDist;
+    localCols = newData.numCols();
+    localData = std::move(newData);
+}
+
+Matrix DistributedMatrix::gatherTo(int root) const
+{
+    MATRIX_ZONE("DistributedMatrix::gatherTo");
+    if (root < 0 || root >= numProcesses)
+        throw std::invalid_argument("Invalid root process for gatherTo");
+    // Every process sends its block to the root, which receives it in place in the full matrix
+    Matrix full(rank == root ? globalRows : 0, rank == root ? globalCols : 0);
+    std::vector<MPI_Request> requests;
+    std::vector<MPI_Datatype> blockTypes;
+    if (rank == root) {
+        requests.resize(numProcesses);
+        blockTypes.resize(numProcesses);
+        for (int p = 0; p < numProcesses; p++) {
+            blockTypes[p] = scatteredBlockType(rowDist, p / grid->cols, colDist, p % grid->cols, globalCols);
+            MPI_Irecv(full.rawData(), 1, blockTypes[p], p, 0, grid->comm, &requests[p]);
+        }
+    }
+    MPI_Send(localData.rawData(), localRows * localCols, MPI_DOUBLE, root, 0, grid->comm);
+    MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+    for (MPI_Datatype& type : blockTypes)
+        MPI_Type_free(&type);
+    return full;
+}
+
+void DistributedMatrix::writeCollective(const std::string& path) const
+{
+    MATRIX_ZONE("DistributedMatrix::writeCollective");
+    MPI_File file;
+    checkFileError(MPI_File_open(grid->comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file),
+                   "open", path);
+    // The file view of each process only shows its own elements (for the column layout, one
+    // column block: a segment of every row), so that a single collective write stores them all
+    MPI_Datatype block = localBlockType(*this), row = localRowType(*this);
+    int error = MPI_File_set_size(file, fileHeaderBytes + static_cast<MPI_Offset>(globalRows) * globalCols * sizeof(double));
+    if (error == MPI_SUCCESS && rank == 0) {
+        int64_t header[2] = {globalRows, globalCols};
+        error = MPI_File_write_at(file, 0, header, 2, MPI_INT64_T, MPI_STATUS_IGNORE);
+    }
+    if (error == MPI_SUCCESS)
+        error = MPI_File_set_view(file, fileHeaderBytes, MPI_DOUBLE, block, "native", MPI_INFO_NULL);
+    if (error == MPI_SUCCESS)
+        error = MPI_File_write_at_all(file, 0, localData.rawData(), localRows, row, MPI_STATUS_IGNORE);
+    MPI_Type_free(&block);
+    MPI_Type_free(&row);
+    // The errors of one process (e.g. a full disk) are reported on all of them
+    MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, grid->comm);
+    MPI_File_close(&file);
+    checkFileError(error, "write", path);
+}
+
+namespace {
+
+// Segments of a MatrixBroadcast: large enough for the per-message costs to vanish, small enough
+// for many of them to be in flight along the broadcast tree
+const long defaultSegmentBytes = 1L << 20;
+
+// From this many elements, sync_matrix pipelines its broadcast
+const long pipelinedMinElements = 1L << 22;
+
+} // namespace
+
+void sync_matrix(Matrix *matrix, int rank, int src, MPI_Comm comm)
+{
+    MATRIX_ZONE("sync_matrix");
+    int dims[2] = {matrix->numRows(), matrix->numCols()};
+#ifdef MATRIX_PERSISTENT_COLLECTIVES
+    if (persistentCollectives()) {
+        CachedCollective& dimsBcast = cachedCollective(BcastDims, comm, src);
+        if (dimsBcast.request == MPI_REQUEST_NULL) {
+            dimsBcast.ints.resize(2);
+            MATRIX_BCAST_INIT(dimsBcast.ints.data(), 2, MPI_INT, src, comm, MPI_INFO_NULL,
+                              &dimsBcast.request);
+        }
+        std::copy(dims, dims + 2, dimsBcast.ints.data());
+        startAndWait(dimsBcast.request);
+        std::copy(dimsBcast.ints.data(), dimsBcast.ints.data() + 2, dims);
+    } else
+#endif
+    {
+        MPI_Bcast(dims, 2, MPI_INT, src, comm);
+    }
+    if (rank != src && (dims[0] != matrix->numRows() || dims[1] != matrix->numCols()))
+        *matrix = Matrix(dims[0], dims[1]);
+
+    const long count = static_cast<long>(dims[0]) * dims[1];
+#ifdef MATRIX_PERSISTENT_COLLECTIVES
+    if (persistentCollectives() && count <= persistentMaxElements) {
+        CachedCollective& dataBcast = cachedCollective(BcastData, comm, src, count);
+        if (dataBcast.request == MPI_REQUEST_NULL) {
+            dataBcast.send.resize(count);
+            MATRIX_BCAST_INIT(dataBcast.send.data(), static_cast<int>(count), MPI_DOUBLE, src, comm,
+                              MPI_INFO_NULL, &dataBcast.request);
+        }
+        if (rank == src)
+            std::copy(matrix->rawData(), matrix->rawData() + count, dataBcast.send.data());
+        startAndWait(dataBcast.request);
+        if (rank != src)
+            std::copy(dataBcast.send.data(), dataBcast.send.data() + count, matrix->rawData());
+        return;
+    }
+#endif
+    if (count >= pipelinedMinElements) {
+        MatrixBroadcast(matrix, rank, src, 0, comm).wait();
+        return;
+    }
+    MPI_Bcast(matrix->rawData(), static_cast<int>(count), MPI_DOUBLE, src, comm);
+}
+
+void sync_matrix(Matrix *matrix, int rank, int src, CollectiveCompression& compression, MPI_Comm comm)
+{
+    MATRIX_ZONE("sync_matrix(compressed)");
+    int dims[2] = {matrix->numRows(), matrix->numCols()};
+    MPI_Bcast(dims, 2, MPI_INT, src, comm);
+    if (rank != src && (dims[0] != matrix->numRows() || dims[1] != matrix->numCols()))
+        *matrix = Matrix(dims[0], dims[1]);
+    compression.broadcast(matrix->rawData(), static_cast<long>(dims[0]) * dims[1], src, comm);
+}
+
+// --- MatrixBroadcast ---
+
+MatrixBroadcast::MatrixBroadcast(Matrix* matrix, int rank, int src, long segmentBytes, MPI_Comm comm)
+    : matrix(matrix), segmentRows(1)
 {
-    // TODO
+    MATRIX_ZONE("MatrixBroadcast");
+    int dims[2] = {matrix->numRows(), matrix->numCols()};
+    MPI_Bcast(dims, 2, MPI_INT, src, comm);
+    if (rank != src && (dims[0] != matrix->numRows() || dims[1] != matrix->numCols()))
+        *matrix = Matrix(dims[0], dims[1]);
+
+    if (segmentBytes <= 0) {
+        const char* value = std::getenv("MATRIX_BCAST_SEGMENT");
+        segmentBytes = value ? std::atol(value) : 0;
+        if (segmentBytes <= 0)
+            segmentBytes = defaultSegmentBytes;
+    }
+    const long rowBytes = static_cast<long>(dims[1]) * sizeof(double);
+    segmentRows = rowBytes > 0 ? static_cast<int>(std::max(1L, std::min<long>(segmentBytes / rowBytes, dims[0]))) : dims[0];
+    const int segments = segmentRows > 0 ? (dims[0] + segmentRows - 1) / segmentRows : 0;
+    requests.resize(segments);
+    for (int s = 0; s < segments; s++)
+        MPI_Ibcast(matrix->rawData() + static_cast<size_t>(segmentBegin(s)) * dims[1],
+                   (segmentEnd(s) - segmentBegin(s)) * dims[1], MPI_DOUBLE, src, comm, &requests[s]);
+}
+
+MatrixBroadcast::~MatrixBroadcast()
+{
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (!finalized)
+        wait();
+}
+
+int MatrixBroadcast::numSegments() const { return static_cast<int>(requests.size()); }
+int MatrixBroadcast::segmentBegin(int segment) const { return segment * segmentRows; }
+int MatrixBroadcast::segmentEnd(int segment) const { return std::min(matrix->numRows(), (segment + 1) * segmentRows); }
+
+bool MatrixBroadcast::testSegment(int segment)
+{
+    int done;
+    MPI_Test(&requests.at(segment), &done, MPI_STATUS_IGNORE);
+    return done != 0;
+}
+
+void MatrixBroadcast::waitSegment(int segment)
+{
+    MPI_Wait(&requests.at(segment), MPI_STATUS_IGNORE);
+}
+
+void MatrixBroadcast::wait()
+{
+    MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+// --- AsyncCheckpoint ---
+
+AsyncCheckpoint::AsyncCheckpoint(const DistributedMatrix& matrix, const std::string& path)
+    : path(path), comm(matrix.getGrid().comm)
+{
+    MATRIX_ZONE("AsyncCheckpoint");
+    const Matrix& local = matrix.getLocalData();
+    snapshot.assign(local.rawData(), local.rawData() + static_cast<size_t>(local.numRows()) * local.numCols());
+
+    // The elements of a local row are runs of consecutive global columns; consecutive runs that
+    // are also consecutive in the file (e.g. whole rows) are written at once
+    const long globalCols = matrix.numCols();
+    std::vector<int> runStarts; // Local columns that start a run
+    for (int l = 0; l < local.numCols(); l++)
+        if (l == 0 || matrix.globalColIndex(l) != matrix.globalColIndex(l - 1) + 1)
+            runStarts.push_back(l);
+    runStarts.push_back(local.numCols());
+    for (int i = 0; i < local.numRows(); i++) {
+        const long row = matrix.globalRowIndex(i);
+        for (size_t r = 0; r + 1 < runStarts.size(); r++) {
+            const size_t first = static_cast<size_t>(i) * local.numCols() + runStarts[r];
+            const size_t count = runStarts[r + 1] - runStarts[r];
+            const long offset = fileHeaderBytes + (row * globalCols + matrix.globalColIndex(runStarts[r])) * static_cast<long>(sizeof(double));
+            Segment* last = segments.empty() ? nullptr : &segments.back();
+            if (last && last->first + last->count == first && last->fileOffset + static_cast<long>(last->count * sizeof(double)) == offset)
+                last->count += count;
+            else
+                segments.push_back({first, offset, count});
+        }
+    }
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    writer = std::thread(&AsyncCheckpoint::write, this, rank == 0, static_cast<long>(matrix.numRows()), globalCols);
+}
+
+AsyncCheckpoint::~AsyncCheckpoint()
+{
+    if (writer.joinable())
+        writer.join();
+}
+
+bool AsyncCheckpoint::written() const
+{
+    return finished.load();
+}
+
+void AsyncCheckpoint::write(bool header, long rows, long cols)
+{
+    const std::string partial = path + ".partial";
+    auto fail = [&](const char* what) { error = std::string("Cannot ") + what + " " + partial + ": " + std::strerror(errno); };
+    const int fd = open(partial.c_str(), O_CREAT | O_WRONLY, 0644);
+    if (fd < 0)
+        fail("open");
+    // Process 0 writes the header and sets the size (a stale file may be larger)
+    if (fd >= 0 && header) {
+        int64_t dims[2] = {rows, cols};
+        if (pwrite(fd, dims, sizeof(dims), 0) != static_cast<ssize_t>(sizeof(dims)) ||
+            ftruncate(fd, fileHeaderBytes + rows * cols * static_cast<long>(sizeof(double))) != 0)
+            fail("write");
+    }
+    for (size_t s = 0; fd >= 0 && error.empty() && s < segments.size(); s++) {
+        const char* data = reinterpret_cast<const char*>(snapshot.data() + segments[s].first);
+        size_t bytes = segments[s].count * sizeof(double);
+        off_t offset = segments[s].fileOffset;
+        while (bytes > 0) { // pwrite may write less than asked
+            const ssize_t done = pwrite(fd, data, bytes, offset);
+            if (done < 0) {
+                fail("write");
+                break;
+            }
+            data += done;
+            bytes -= done;
+            offset += done;
+        }
+    }
+    // On disk before the commit, so that a committed checkpoint survives the crash of a node
+    if (fd >= 0 && error.empty() && fsync(fd) != 0)
+        fail("sync");
+    if (fd >= 0 && close(fd) != 0 && error.empty())
+        fail("close");
+    std::vector<double>().swap(snapshot);
+    finished.store(true);
+}
+
+void AsyncCheckpoint::commit()
+{
+    MATRIX_ZONE("AsyncCheckpoint::commit");
+    if (writer.joinable())
+        writer.join();
+    int failed = error.empty() ? 0 : 1;
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, comm);
+    if (failed)
+        throw std::runtime_error(error.empty() ? "Cannot write checkpoint " + path + ": failed on another process" : error);
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int renamed = 0;
+    if (rank == 0)
+        renamed = std::rename((path + ".partial").c_str(), path.c_str()) == 0 ? 0 : errno;
+    MPI_Bcast(&renamed, 1, MPI_INT, 0, comm);
+    if (renamed != 0)
+        throw std::runtime_error("Cannot rename " + path + ".partial to " + path + ": " + std::strerror(renamed));
+}
+
+// --- GradientSynchronizer ---
+
+namespace {
+
+// Buckets of a GradientSynchronizer: a few large allreduces rather than one per (possibly small)
+// gradient, yet several of them so that the first ones overlap with the rest of backpropagation
+const long defaultBucketBytes = 1L << 20;
+
+} // namespace
+
+GradientSynchronizer::GradientSynchronizer(const std::vector<Matrix*>& gradients, long bucketBytes, MPI_Comm comm)
+    : comm(comm), gradients(gradients), bucketOf(gradients.size()), offsetOf(gradients.size()), isReady(gradients.size(), false)
+{
+    if (bucketBytes <= 0) {
+        const char* value = std::getenv("MATRIX_GRADIENT_BUCKET");
+        bucketBytes = value ? std::atol(value) : 0;
+        if (bucketBytes <= 0)
+            bucketBytes = defaultBucketBytes;
+    }
+    long bytes = bucketBytes;
+    for (size_t i = 0; i < gradients.size(); i++) {
+        if (bytes >= bucketBytes) {
+            buckets.emplace_back();
+            bytes = 0;
+        }
+        Bucket& bucket = buckets.back();
+        bucketOf[i] = static_cast<int>(buckets.size()) - 1;
+        offsetOf[i] = bytes / static_cast<long>(sizeof(double));
+        bucket.gradients.push_back(static_cast<int>(i));
+        bytes += static_cast<long>(gradients[i]->numRows()) * gradients[i]->numCols() * sizeof(double);
+    }
+    for (Bucket& bucket : buckets) {
+        bucket.pending = static_cast<int>(bucket.gradients.size());
+        if (bucket.gradients.size() > 1) {
+            const Matrix* last = gradients[bucket.gradients.back()];
+            bucket.buffer.resize(offsetOf[bucket.gradients.back()] + static_cast<size_t>(last->numRows()) * last->numCols());
+        }
+    }
+}
+
+GradientSynchronizer::~GradientSynchronizer()
+{
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (finalized)
+        return;
+    for (Bucket& bucket : buckets)
+        MPI_Wait(&bucket.request, MPI_STATUS_IGNORE);
+}
+
+int GradientSynchronizer::numBuckets() const { return static_cast<int>(buckets.size()); }
+
+void GradientSynchronizer::ready(int index)
+{
+    MATRIX_ZONE("GradientSynchronizer::ready");
+    if (index < 0 || index >= static_cast<int>(gradients.size()))
+        throw std::out_of_range("Gradient index out of range");
+    if (isReady[index])
+        throw std::logic_error("Gradient already ready in this step");
+    isReady[index] = true;
+
+    Bucket& bucket = buckets[bucketOf[index]];
+    const Matrix& gradient = *gradients[index];
+    const size_t count = static_cast<size_t>(gradient.numRows()) * gradient.numCols();
+    if (!bucket.buffer.empty())
+        std::copy(gradient.rawData(), gradient.rawData() + count, bucket.buffer.begin() + offsetOf[index]);
+    if (--bucket.pending == 0) {
+        double* data = bucket.buffer.empty() ? gradients[index]->rawData() : bucket.buffer.data();
+        const int total = bucket.buffer.empty() ? static_cast<int>(count) : static_cast<int>(bucket.buffer.size());
+        MPI_Iallreduce(MPI_IN_PLACE, data, total, MPI_DOUBLE, MPI_SUM, comm, &bucket.request);
+    }
+
+    // Lets the allreduces in flight progress while backpropagation goes on
+    for (Bucket& other : buckets)
+        if (other.request != MPI_REQUEST_NULL) {
+            int done;
+            MPI_Test(&other.request, &done, MPI_STATUS_IGNORE);
+        }
+}
+
+void GradientSynchronizer::wait()
+{
+    MATRIX_ZONE("GradientSynchronizer::wait");
+    for (bool ready : isReady)
+        if (!ready)
+            throw std::logic_error("Every gradient must be ready before wait");
+
+    int numProcs;
+    MPI_Comm_size(comm, &numProcs);
+    const double scale = 1.0 / numProcs;
+    for (Bucket& bucket : buckets) {
+        MPI_Wait(&bucket.request, MPI_STATUS_IGNORE);
+        for (int i : bucket.gradients) {
+            Matrix& gradient = *gradients[i];
+            const size_t count = static_cast<size_t>(gradient.numRows()) * gradient.numCols();
+            const double* sum = bucket.buffer.empty() ? gradient.rawData() : bucket.buffer.data() + offsetOf[i];
+            double* average = gradient.rawData();
+            for (size_t k = 0; k < count; k++)
+                average[k] = sum[k] * scale;
+        }
+        bucket.pending = static_cast<int>(bucket.gradients.size());
+    }
+    std::fill(isReady.begin(), isReady.end(), false);
+}
+
+void dataParallelGradientDescent(const std::vector<Matrix*>& parameters, const std::vector<Matrix*>& gradients,
+                                 double learningRate, int steps,
+                                 const std::function<void(GradientSynchronizer& sync)>& backward, long bucketBytes,
+                                 MPI_Comm comm)
+{
+    MATRIX_ZONE("dataParallelGradientDescent");
+    if (parameters.size() != gradients.size())
+        throw std::invalid_argument("Every parameter needs a gradient");
+    for (size_t i = 0; i < parameters.size(); i++)
+        if (parameters[i]->numRows() != gradients[i]->numRows() || parameters[i]->numCols() != gradients[i]->numCols())
+            throw std::invalid_argument("Parameter and gradient dimensions must match");
+
+    GradientSynchronizer sync(gradients, bucketBytes, comm);
+    for (int step = 0; step < steps; step++) {
+        backward(sync);
+        sync.wait();
+        for (size_t i = 0; i < parameters.size(); i++)
+            parameters[i]->sub_mul(learningRate, *gradients[i]);
+    }
 }
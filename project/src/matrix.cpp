@@ -1,89 +1,958 @@
 #include "matrix.hpp"
+#include "instrumentation.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define MATRIX_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+// Elements are stored in row-major order: element (i, j) is data[i * cols + j].
+
+namespace {
+
+// --- Kernels ---
+//
+// The compute kernels are compiled once per instruction set (generic, SSE2, AVX2 + FMA,
+// AVX-512) with the GCC `target` attribute, and gathered in one `KernelTable` per
+// instruction set. The best table supported by the CPU is selected at startup, so a single
+// binary uses AVX-512 on the nodes that have it and falls back to AVX2 or SSE2 elsewhere.
+// The selection can be lowered with the environment variable `MATRIX_ISA` or with
+// `Matrix::useKernelISA`, e.g. to compare the instruction sets on the same machine.
+
+#define MATRIX_ALWAYS_INLINE inline __attribute__((always_inline))
+#ifdef MATRIX_X86_DISPATCH
+// SSE2 is the baseline of x86-64, where the generic element-wise kernels already use it: the
+// sse2 table differs from the generic one by its GEMM micro-kernels and transpose there, and
+// also by its element-wise kernels on 32-bit x86 (x87 arithmetic otherwise)
+#define MATRIX_TARGET_SSE2 __attribute__((target("sse2")))
+#define MATRIX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define MATRIX_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+// GEMM micro-kernel: c[0:mr, 0:nr] += a * b where `a` is a packed sliver of MR rows
+// (a[p * MR + i] is row i, column p) and `b` a packed sliver of NR columns (b[p * NR + j]).
+// `mr <= MR` and `nr <= NR` handle the blocks at the border of C.
+typedef void (*MicroKernelFn)(int kc, const double *a, const double *b, double *c, long ldc, int mr, int nr);
+
+struct MicroKernel
+{
+    int mr, nr;
+    MicroKernelFn run;
+};
+
+struct KernelTable
+{
+    const char *isa;
+    std::vector<MicroKernel> gemm; // Shapes of the GEMM micro-kernel, the first one is the default
+    void (*fill)(double *c, double value, long n);
+    void (*add)(const double *a, const double *b, double *c, long n);
+    void (*sub)(const double *a, const double *b, double *c, long n);
+    void (*scale)(const double *a, double scalar, double *c, long n);
+    void (*subMul)(double *a, double scalar, const double *b, long n);
+    double (*sum)(const double *a, long n);
+    // t[j * ldt + i] = a[i * lda + j] for a tile of `rows x cols` elements of `a`
+    void (*transposeTile)(const double *a, long lda, double *t, long ldt, int rows, int cols);
+};
+
+// Element-wise kernels: one body, inlined in the wrapper of every instruction set where
+// `omp simd` vectorizes it with the vector width of that instruction set.
+
+MATRIX_ALWAYS_INLINE void fillBody(double *c, double value, long n)
+{
+#pragma omp simd
+    for (long k = 0; k < n; ++k)
+        c[k] = value;
+}
+
+MATRIX_ALWAYS_INLINE void addBody(const double *a, const double *b, double *c, long n)
+{
+#pragma omp simd
+    for (long k = 0; k < n; ++k)
+        c[k] = a[k] + b[k];
+}
+
+MATRIX_ALWAYS_INLINE void subBody(const double *a, const double *b, double *c, long n)
+{
+#pragma omp simd
+    for (long k = 0; k < n; ++k)
+        c[k] = a[k] - b[k];
+}
+
+MATRIX_ALWAYS_INLINE void scaleBody(const double *a, double scalar, double *c, long n)
+{
+#pragma omp simd
+    for (long k = 0; k < n; ++k)
+        c[k] = scalar * a[k];
+}
+
+MATRIX_ALWAYS_INLINE void subMulBody(double *a, double scalar, const double *b, long n)
+{
+#pragma omp simd
+    for (long k = 0; k < n; ++k)
+        a[k] -= scalar * b[k];
+}
+
+MATRIX_ALWAYS_INLINE double sumBody(const double *a, long n)
+{
+    double s = 0.0;
+#pragma omp simd reduction(+ : s)
+    for (long k = 0; k < n; ++k)
+        s += a[k];
+    return s;
+}
+
+MATRIX_ALWAYS_INLINE void transposeScalar(const double *a, long lda, double *t, long ldt, int rows, int cols)
+{
+    for (int i = 0; i < rows; ++i)
+        for (int j = 0; j < cols; ++j)
+            t[j * ldt + i] = a[i * lda + j];
+}
+
+#define MATRIX_ELEMENTWISE_KERNELS(isa, target)                                                                   \
+    target void fill_##isa(double *c, double value, long n) { fillBody(c, value, n); }                           \
+    target void add_##isa(const double *a, const double *b, double *c, long n) { addBody(a, b, c, n); }          \
+    target void sub_##isa(const double *a, const double *b, double *c, long n) { subBody(a, b, c, n); }          \
+    target void scale_##isa(const double *a, double scalar, double *c, long n) { scaleBody(a, scalar, c, n); }   \
+    target void subMul_##isa(double *a, double scalar, const double *b, long n) { subMulBody(a, scalar, b, n); } \
+    target double sum_##isa(const double *a, long n) { return sumBody(a, n); }
+
+MATRIX_ELEMENTWISE_KERNELS(generic, )
+
+template <int MR, int NR>
+void microGeneric(int kc, const double *a, const double *b, double *c, long ldc, int mr, int nr)
+{
+    double acc[MR][NR] = {};
+    for (int p = 0; p < kc; ++p)
+        for (int i = 0; i < MR; ++i)
+            for (int j = 0; j < NR; ++j)
+                acc[i][j] += a[p * MR + i] * b[p * NR + j];
+    for (int i = 0; i < mr; ++i)
+        for (int j = 0; j < nr; ++j)
+            c[i * ldc + j] += acc[i][j];
+}
+
+#ifdef MATRIX_X86_DISPATCH
+
+MATRIX_ELEMENTWISE_KERNELS(sse2, MATRIX_TARGET_SSE2)
+MATRIX_ELEMENTWISE_KERNELS(avx2, MATRIX_TARGET_AVX2)
+MATRIX_ELEMENTWISE_KERNELS(avx512, MATRIX_TARGET_AVX512)
+
+// Adds the MR x NR accumulators stored in `acc` to the mr x nr block of C
+template <int MR, int NR>
+MATRIX_ALWAYS_INLINE void addToC(const double *acc, double *c, long ldc, int mr, int nr)
+{
+    for (int i = 0; i < mr; ++i)
+        for (int j = 0; j < nr; ++j)
+            c[i * ldc + j] += acc[i * NR + j];
+}
+
+// SSE2 (baseline of x86-64): 2 doubles per register, no FMA
+template <int MR>
+void microSse2(int kc, const double *a, const double *b, double *c, long ldc, int mr, int nr)
+{
+    __m128d acc[MR][2];
+#pragma GCC unroll 16
+    for (int i = 0; i < MR; ++i)
+        acc[i][0] = acc[i][1] = _mm_setzero_pd();
+    for (int p = 0; p < kc; ++p)
+    {
+        const __m128d b0 = _mm_loadu_pd(b + p * 4), b1 = _mm_loadu_pd(b + p * 4 + 2);
+#pragma GCC unroll 16
+        for (int i = 0; i < MR; ++i)
+        {
+            const __m128d ai = _mm_set1_pd(a[p * MR + i]);
+            acc[i][0] = _mm_add_pd(acc[i][0], _mm_mul_pd(ai, b0));
+            acc[i][1] = _mm_add_pd(acc[i][1], _mm_mul_pd(ai, b1));
+        }
+    }
+    alignas(64) double out[MR * 4];
+    for (int i = 0; i < MR; ++i)
+    {
+        _mm_store_pd(out + i * 4, acc[i][0]);
+        _mm_store_pd(out + i * 4 + 2, acc[i][1]);
+    }
+    addToC<MR, 4>(out, c, ldc, mr, nr);
+}
+
+// AVX2 + FMA: 4 doubles per register, 2 registers per row of the block
+template <int MR>
+MATRIX_TARGET_AVX2 void microAvx2(int kc, const double *a, const double *b, double *c, long ldc, int mr, int nr)
+{
+    __m256d acc[MR][2];
+#pragma GCC unroll 16
+    for (int i = 0; i < MR; ++i)
+        acc[i][0] = acc[i][1] = _mm256_setzero_pd();
+    for (int p = 0; p < kc; ++p)
+    {
+        const __m256d b0 = _mm256_loadu_pd(b + p * 8), b1 = _mm256_loadu_pd(b + p * 8 + 4);
+#pragma GCC unroll 16
+        for (int i = 0; i < MR; ++i)
+        {
+            const __m256d ai = _mm256_broadcast_sd(a + p * MR + i);
+            acc[i][0] = _mm256_fmadd_pd(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_pd(ai, b1, acc[i][1]);
+        }
+    }
+    alignas(64) double out[MR * 8];
+    for (int i = 0; i < MR; ++i)
+    {
+        _mm256_store_pd(out + i * 8, acc[i][0]);
+        _mm256_store_pd(out + i * 8 + 4, acc[i][1]);
+    }
+    addToC<MR, 8>(out, c, ldc, mr, nr);
+}
+
+// AVX-512: 8 doubles per register, 2 registers per row of the block
+template <int MR>
+MATRIX_TARGET_AVX512 void microAvx512(int kc, const double *a, const double *b, double *c, long ldc, int mr, int nr)
+{
+    __m512d acc[MR][2];
+#pragma GCC unroll 16
+    for (int i = 0; i < MR; ++i)
+        acc[i][0] = acc[i][1] = _mm512_setzero_pd();
+    for (int p = 0; p < kc; ++p)
+    {
+        const __m512d b0 = _mm512_loadu_pd(b + p * 16), b1 = _mm512_loadu_pd(b + p * 16 + 8);
+#pragma GCC unroll 16
+        for (int i = 0; i < MR; ++i)
+        {
+            const __m512d ai = _mm512_set1_pd(a[p * MR + i]);
+            acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+        }
+    }
+    alignas(64) double out[MR * 16];
+    for (int i = 0; i < MR; ++i)
+    {
+        _mm512_store_pd(out + i * 16, acc[i][0]);
+        _mm512_store_pd(out + i * 16 + 8, acc[i][1]);
+    }
+    addToC<MR, 16>(out, c, ldc, mr, nr);
+}
+
+// 2 x 2 blocks transposed in registers
+void transposeTileSse2(const double *a, long lda, double *t, long ldt, int rows, int cols)
+{
+    int i = 0;
+    for (; i + 2 <= rows; i += 2)
+    {
+        int j = 0;
+        for (; j + 2 <= cols; j += 2)
+        {
+            const __m128d r0 = _mm_loadu_pd(a + i * lda + j);       // a00 a01
+            const __m128d r1 = _mm_loadu_pd(a + (i + 1) * lda + j); // a10 a11
+            _mm_storeu_pd(t + j * ldt + i, _mm_unpacklo_pd(r0, r1));
+            _mm_storeu_pd(t + (j + 1) * ldt + i, _mm_unpackhi_pd(r0, r1));
+        }
+        transposeScalar(a + i * lda + j, lda, t + j * ldt + i, ldt, 2, cols - j);
+    }
+    transposeScalar(a + i * lda, lda, t + i, ldt, rows - i, cols);
+}
+
+// 4 x 4 blocks transposed in registers (shared by the AVX2 and AVX-512 tables)
+__attribute__((target("avx"))) void transposeTileAvx(const double *a, long lda, double *t, long ldt, int rows, int cols)
+{
+    int i = 0;
+    for (; i + 4 <= rows; i += 4)
+    {
+        int j = 0;
+        for (; j + 4 <= cols; j += 4)
+        {
+            const __m256d r0 = _mm256_loadu_pd(a + i * lda + j);
+            const __m256d r1 = _mm256_loadu_pd(a + (i + 1) * lda + j);
+            const __m256d r2 = _mm256_loadu_pd(a + (i + 2) * lda + j);
+            const __m256d r3 = _mm256_loadu_pd(a + (i + 3) * lda + j);
+            const __m256d t0 = _mm256_unpacklo_pd(r0, r1); // a00 a10 a02 a12
+            const __m256d t1 = _mm256_unpackhi_pd(r0, r1); // a01 a11 a03 a13
+            const __m256d t2 = _mm256_unpacklo_pd(r2, r3); // a20 a30 a22 a32
+            const __m256d t3 = _mm256_unpackhi_pd(r2, r3); // a21 a31 a23 a33
+            _mm256_storeu_pd(t + j * ldt + i, _mm256_permute2f128_pd(t0, t2, 0x20));
+            _mm256_storeu_pd(t + (j + 1) * ldt + i, _mm256_permute2f128_pd(t1, t3, 0x20));
+            _mm256_storeu_pd(t + (j + 2) * ldt + i, _mm256_permute2f128_pd(t0, t2, 0x31));
+            _mm256_storeu_pd(t + (j + 3) * ldt + i, _mm256_permute2f128_pd(t1, t3, 0x31));
+        }
+        transposeScalar(a + i * lda + j, lda, t + j * ldt + i, ldt, 4, cols - j);
+    }
+    transposeScalar(a + i * lda, lda, t + i, ldt, rows - i, cols);
+}
+
+#endif // MATRIX_X86_DISPATCH
+
+void transposeTileGeneric(const double *a, long lda, double *t, long ldt, int rows, int cols)
+{
+    transposeScalar(a, lda, t, ldt, rows, cols);
+}
+
+#define MATRIX_KERNEL_TABLE(isa, transposeTile, ...) \
+    KernelTable{#isa, {__VA_ARGS__}, fill_##isa, add_##isa, sub_##isa, scale_##isa, subMul_##isa, sum_##isa, transposeTile}
+
+// Tables from the most to the least capable instruction set
+const std::vector<KernelTable> &kernelTables()
+{
+    static const std::vector<KernelTable> tables = {
+#ifdef MATRIX_X86_DISPATCH
+        MATRIX_KERNEL_TABLE(avx512, transposeTileAvx,
+                            MicroKernel{8, 16, microAvx512<8>}, MicroKernel{12, 16, microAvx512<12>}),
+        MATRIX_KERNEL_TABLE(avx2, transposeTileAvx,
+                            MicroKernel{6, 8, microAvx2<6>}, MicroKernel{4, 8, microAvx2<4>}),
+        MATRIX_KERNEL_TABLE(sse2, transposeTileSse2,
+                            MicroKernel{4, 4, microSse2<4>}, MicroKernel{6, 4, microSse2<6>}),
+#endif
+        MATRIX_KERNEL_TABLE(generic, transposeTileGeneric, MicroKernel{4, 4, microGeneric<4, 4>}),
+    };
+    return tables;
+}
+
+bool cpuSupports(const std::string &isa)
+{
+#ifdef MATRIX_X86_DISPATCH
+    if (isa == "avx512")
+        return __builtin_cpu_supports("avx512f");
+    if (isa == "avx2")
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (isa == "sse2")
+        return __builtin_cpu_supports("sse2");
+#endif
+    return isa == "generic";
+}
+
+const KernelTable *findTable(const std::string &isa)
+{
+    for (const KernelTable &table : kernelTables())
+        if (isa == table.isa)
+            return cpuSupports(isa) ? &table : nullptr;
+    return nullptr;
+}
+
+// The best table supported by the CPU, or the one requested by `MATRIX_ISA` if supported
+const KernelTable *selectKernels()
+{
+    if (const char *requested = std::getenv("MATRIX_ISA"))
+        if (const KernelTable *table = findTable(requested))
+            return table;
+    for (const KernelTable &table : kernelTables())
+        if (cpuSupports(table.isa))
+            return &table;
+    return &kernelTables().back();
+}
+
+const KernelTable *&activeKernels()
+{
+    static const KernelTable *table = selectKernels();
+    return table;
+}
+
+const KernelTable &kernels()
+{
+    return *activeKernels();
+}
+
+// --- Parallel drivers ---
+
+// Element-wise loops over fewer elements than this per thread are not worth the cost of
+// starting an OpenMP parallel region.
+const long parallelGrain = 1L << 15;
+
+// Splits [0, n) into one contiguous chunk per OpenMP thread and calls `body(begin, end)` on each.
+template <typename Body>
+void forEachChunk(long n, const Body &body)
+{
+#pragma omp parallel if (n >= 2 * parallelGrain)
+    {
+        long begin = 0, end = n;
+#ifdef _OPENMP
+        const long thread = omp_get_thread_num(), numThreads = omp_get_num_threads();
+        begin = n * thread / numThreads;
+        end = n * (thread + 1) / numThreads;
+#endif
+        body(begin, end);
+    }
+}
+
+int roundUp(int x, int multiple)
+{
+    return (x + multiple - 1) / multiple * multiple;
+}
+
+// Packs rows [0, mc) x columns [0, kc) of A into slivers of MR rows, padded with zeros
+void packA(const double *a, long lda, int mc, int kc, int MR, double *packed)
+{
+    for (int ir = 0; ir < mc; ir += MR)
+    {
+        const int mr = std::min(MR, mc - ir);
+        for (int p = 0; p < kc; ++p)
+        {
+            for (int i = 0; i < mr; ++i)
+                packed[p * MR + i] = a[(ir + i) * lda + p];
+            for (int i = mr; i < MR; ++i)
+                packed[p * MR + i] = 0.0;
+        }
+        packed += MR * kc;
+    }
+}
+
+// Packs the sliver of NR columns starting at column `jr` of a kc x nc panel of B, padded with zeros
+void packBSliver(const double *b, long ldb, int kc, int nc, int jr, int NR, double *packed)
+{
+    const int nr = std::min(NR, nc - jr);
+    for (int p = 0; p < kc; ++p)
+    {
+        for (int j = 0; j < nr; ++j)
+            packed[p * NR + j] = b[p * ldb + jr + j];
+        for (int j = nr; j < NR; ++j)
+            packed[p * NR + j] = 0.0;
+    }
+}
+
+// c += a * b with a (m x k), b (k x n) and c (m x n) in row-major order.
+// Cache blocking: a kc x nc panel of B stays in the L3 cache, an mc x kc block of A in the
+// L2 cache and a kc x NR sliver of B in the L1 cache while the micro-kernel runs.
+void gemm(int m, int n, int k, const double *a, const double *b, double *c, const Matrix::GemmTuning &tuning)
+{
+    const MicroKernel &micro = kernels().gemm[tuning.microKernel];
+    const int MR = micro.mr, NR = micro.nr;
+    const int mc = roundUp(tuning.mc, MR), kc = tuning.kc, nc = roundUp(tuning.nc, NR);
+    // Below ~64^3 multiply-adds, a parallel region costs more than it saves
+    [[maybe_unused]] const bool parallel = static_cast<double>(m) * n * k >= 262144.0;
+    [[maybe_unused]] int numThreads = 1;
+#ifdef _OPENMP
+    // A persisted number of threads is an upper bound: it was tuned with the whole host, while
+    // OMP_NUM_THREADS may give this process fewer cores (several MPI processes per host)
+    numThreads = tuning.threads > 0 ? std::min(tuning.threads, omp_get_max_threads()) : omp_get_max_threads();
+#endif
+
+    thread_local std::vector<double> bPanel;
+    bPanel.resize(static_cast<size_t>(kc) * nc);
+    double *bPacked = bPanel.data();
+
+    for (int jc = 0; jc < n; jc += nc)
+    {
+        const int ncb = std::min(nc, n - jc);
+        for (int pc = 0; pc < k; pc += kc)
+        {
+            const int kcb = std::min(kc, k - pc);
+#pragma omp parallel if (parallel) num_threads(numThreads)
+            {
+#pragma omp for schedule(static)
+                for (int jr = 0; jr < ncb; jr += NR)
+                    packBSliver(b + static_cast<long>(pc) * n + jc, n, kcb, ncb, jr, NR, bPacked + jr * kcb);
+
+                thread_local std::vector<double> aBlock;
+                aBlock.resize(static_cast<size_t>(mc) * kcb);
+                double *aPacked = aBlock.data();
+#pragma omp for schedule(dynamic)
+                for (int ic = 0; ic < m; ic += mc)
+                {
+                    const int mcb = std::min(mc, m - ic);
+                    packA(a + static_cast<long>(ic) * k + pc, k, mcb, kcb, MR, aPacked);
+                    for (int jr = 0; jr < ncb; jr += NR)
+                        for (int ir = 0; ir < mcb; ir += MR)
+                            micro.run(kcb, aPacked + ir * kcb, bPacked + jr * kcb,
+                                      c + static_cast<long>(ic + ir) * n + jc + jr, n,
+                                      std::min(MR, mcb - ir), std::min(NR, ncb - jr));
+                }
+            }
+        }
+    }
+}
+
+// --- GEMM tuning ---
+//
+// The best block sizes depend on the cache sizes and on the micro-kernel, so they are
+// tuned once per host and instruction set and stored in a small text file, one line per
+// host: `isa L1d L2 L3 mc kc nc microKernel threads cpu model`. The tuning of the host is
+// loaded on the first GEMM; when there is none, the defaults are derived from the cache
+// sizes. The tuner only runs when asked (Matrix::autotuneGemm, `make tune_gemm`): it would
+// otherwise run in every MPI process of the host at once, competing for the same cores.
+
+struct HostKey
+{
+    std::string isa;
+    long l1 = 0, l2 = 0, l3 = 0; // Data cache sizes in bytes, 0 if unknown
+    std::string cpu;
+
+    bool operator==(const HostKey &other) const
+    {
+        return isa == other.isa && l1 == other.l1 && l2 == other.l2 && l3 == other.l3 && cpu == other.cpu;
+    }
+};
+
+std::string cpuModel()
+{
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+        if (line.compare(0, 10, "model name") == 0)
+        {
+            const size_t colon = line.find(':');
+            if (colon != std::string::npos && colon + 2 <= line.size())
+                return line.substr(colon + 2);
+        }
+    return "unknown";
+}
+
+long cacheSize(int level)
+{
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE) && defined(_SC_LEVEL3_CACHE_SIZE)
+    const long size = sysconf(level == 1 ? _SC_LEVEL1_DCACHE_SIZE : level == 2 ? _SC_LEVEL2_CACHE_SIZE : _SC_LEVEL3_CACHE_SIZE);
+    return size > 0 ? size : 0;
+#else
+    (void)level;
+    return 0;
+#endif
+}
+
+HostKey hostKey()
+{
+    static const HostKey host = {"", cacheSize(1), cacheSize(2), cacheSize(3), cpuModel()};
+    HostKey key = host;
+    key.isa = kernels().isa;
+    return key;
+}
+
+// Blocking derived from the cache sizes: a sliver of B fills half of the L1 cache, a
+// block of A half of the L2 cache and a panel of B half of the L3 cache (per core).
+Matrix::GemmTuning modelTuning(const HostKey &host)
+{
+    Matrix::GemmTuning tuning;
+    const MicroKernel &micro = kernels().gemm[tuning.microKernel];
+    const long doubles = sizeof(double);
+    if (host.l1 > 0)
+        tuning.kc = std::max(64L, std::min(512L, host.l1 / 2 / (micro.nr * doubles)) / 16 * 16);
+    if (host.l2 > 0)
+        tuning.mc = std::max<long>(micro.mr, std::min(384L, host.l2 / 2 / (tuning.kc * doubles)) / micro.mr * micro.mr);
+    if (host.l3 > 0)
+    {
+        long cores = 1;
+#ifdef _OPENMP
+        cores = omp_get_num_procs();
+#endif
+        tuning.nc = std::max<long>(micro.nr, std::min(8192L, host.l3 / cores / 2 / (tuning.kc * doubles)) / micro.nr * micro.nr);
+    }
+    return tuning;
+}
+
+std::string tuningFile()
+{
+    if (const char *path = std::getenv("MATRIX_TUNING_FILE"))
+        return path;
+    std::string dir;
+    if (const char *cache = std::getenv("XDG_CACHE_HOME"))
+        dir = cache;
+    else if (const char *home = std::getenv("HOME"))
+        dir = std::string(home) + "/.cache";
+    else
+        return "matrix_gemm_tuning.txt";
+    return dir + "/matrix_gemm_tuning.txt";
+}
+
+bool validTuning(const Matrix::GemmTuning &tuning)
+{
+    return tuning.mc > 0 && tuning.kc > 0 && tuning.nc > 0 && tuning.threads >= 0 && tuning.microKernel >= 0 &&
+           tuning.microKernel < static_cast<int>(kernels().gemm.size());
+}
+
+// Reads the lines of the tuning file; `found` receives the tuning of `host` if there is one
+std::vector<std::string> readTuningFile(const HostKey &host, Matrix::GemmTuning *found, bool *hasEntry)
+{
+    std::vector<std::string> lines;
+    std::ifstream in(tuningFile());
+    std::string line;
+    *hasEntry = false;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        HostKey key;
+        Matrix::GemmTuning tuning;
+        if (!(fields >> key.isa >> key.l1 >> key.l2 >> key.l3 >> tuning.mc >> tuning.kc >> tuning.nc >>
+              tuning.microKernel >> tuning.threads))
+            continue; // Malformed line: dropped when the file is rewritten
+        fields >> std::ws;
+        std::getline(fields, key.cpu);
+        if (key == host)
+        {
+            if (validTuning(tuning))
+            {
+                *found = tuning;
+                *hasEntry = true;
+            }
+            continue;
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// Replaces the entry of `host` in the tuning file; returns false if the file cannot be written
+bool saveTuning(const HostKey &host, const Matrix::GemmTuning &tuning)
+{
+    Matrix::GemmTuning previous;
+    bool hasEntry;
+    std::vector<std::string> lines = readTuningFile(host, &previous, &hasEntry);
+    std::ostringstream entry;
+    entry << host.isa << ' ' << host.l1 << ' ' << host.l2 << ' ' << host.l3 << ' ' << tuning.mc << ' ' << tuning.kc
+          << ' ' << tuning.nc << ' ' << tuning.microKernel << ' ' << tuning.threads << ' ' << host.cpu;
+    lines.push_back(entry.str());
+
+    // Write to a temporary file then rename it, so that concurrent runs never read a partial file
+    const std::string path = tuningFile();
+    const size_t slash = path.rfind('/');
+    if (slash != std::string::npos && slash > 0)
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    const std::string temporary = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream out(temporary);
+        for (const std::string &line : lines)
+            out << line << '\n';
+        if (!out)
+            return false;
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+double secondsNow()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Best of 3 timings of an n x n GEMM with `tuning`
+double timeGemm(int n, const std::vector<double> &a, const std::vector<double> &b, std::vector<double> &c,
+                const Matrix::GemmTuning &tuning)
+{
+    double best = 0.0;
+    for (int run = 0; run < 3; ++run)
+    {
+        const double start = secondsNow();
+        gemm(n, n, n, a.data(), b.data(), c.data(), tuning);
+        const double elapsed = secondsNow() - start;
+        if (run == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+// Coordinate descent over the micro-kernel shape, the block sizes and the number of threads,
+// starting from the model derived from the cache sizes: each parameter in turn takes the
+// value of its candidates that is the fastest with the others fixed.
+Matrix::GemmTuning searchTuning(int n, const HostKey &host)
+{
+    std::vector<double> a(static_cast<size_t>(n) * n), b(a.size()), c(a.size());
+    for (size_t k = 0; k < a.size(); ++k)
+    {
+        a[k] = static_cast<double>(k % 17) / 17.0;
+        b[k] = static_cast<double>(k % 13) / 13.0;
+    }
+
+    std::vector<int> kernelCandidates, threadCandidates = {0};
+    for (size_t i = 0; i < kernels().gemm.size(); ++i)
+        kernelCandidates.push_back(static_cast<int>(i));
+#ifdef _OPENMP
+    for (int t = omp_get_max_threads() / 2; t >= 1; t /= 2)
+        threadCandidates.push_back(t);
+#endif
+    const std::vector<int> mcCandidates = {48, 72, 96, 144, 192, 288};
+    const std::vector<int> kcCandidates = {128, 192, 256, 384, 512};
+    const std::vector<int> ncCandidates = {512, 1024, 2048, 4096};
+
+    Matrix::GemmTuning best = modelTuning(host);
+    double bestTime = timeGemm(n, a, b, c, best);
+    auto tryValues = [&](int Matrix::GemmTuning::*field, const std::vector<int> &candidates) {
+        for (int value : candidates)
+        {
+            Matrix::GemmTuning candidate = best;
+            candidate.*field = value;
+            const double time = timeGemm(n, a, b, c, candidate);
+            if (time < bestTime)
+            {
+                bestTime = time;
+                best = candidate;
+            }
+        }
+    };
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        tryValues(&Matrix::GemmTuning::microKernel, kernelCandidates);
+        tryValues(&Matrix::GemmTuning::kc, kcCandidates);
+        tryValues(&Matrix::GemmTuning::mc, mcCandidates);
+        tryValues(&Matrix::GemmTuning::nc, ncCandidates);
+    }
+    tryValues(&Matrix::GemmTuning::threads, threadCandidates);
+    return best;
+}
+
+// Tuning of the active instruction set, loaded when the instruction set changes
+struct TuningState
+{
+    std::mutex mutex; // The GEMM may run on several threads of the application
+    const KernelTable *table = nullptr;
+    Matrix::GemmTuning tuning;
+};
+
+TuningState &tuningState()
+{
+    static TuningState state;
+    return state;
+}
+
+// Loads the tuning of the active instruction set if needed; the caller holds the mutex
+void loadTuning(TuningState &state)
+{
+    if (state.table != &kernels())
+    {
+        state.table = &kernels();
+        const HostKey host = hostKey();
+        bool hasEntry;
+        readTuningFile(host, &state.tuning, &hasEntry);
+        if (!hasEntry)
+            state.tuning = modelTuning(host);
+    }
+}
+
+Matrix::GemmTuning activeTuning()
+{
+    TuningState &state = tuningState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    loadTuning(state);
+    return state.tuning;
+}
+
+void setActiveTuning(const Matrix::GemmTuning &tuning)
+{
+    TuningState &state = tuningState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    loadTuning(state);
+    state.tuning = tuning;
+}
+
+} // namespace
 
 Matrix::Matrix(int rows, int cols)
-    : rows(0), cols(0)
+    : rows(rows), cols(cols)
 {
-    // TODO
+    if (rows < 0 || cols < 0)
+        throw std::invalid_argument("Matrix dimensions must be non-negative");
+    data.assign(static_cast<size_t>(rows) * cols, 0.0);
 }
 
 Matrix::Matrix(const Matrix &other)
-    : rows(0), cols(0)
+    : rows(other.rows), cols(other.cols), data(other.data)
+{
+}
+
+Matrix::Matrix(Matrix &&other) noexcept
+    : rows(other.rows), cols(other.cols), data(std::move(other.data))
 {
-    // TODO
+    other.rows = other.cols = 0;
+    other.data.clear();
 }
 
 int Matrix::numRows() const
 {
-    return 0; // TODO
+    return rows;
 }
 
 int Matrix::numCols() const
 {
-    return 0; // TODO
+    return cols;
 }
 
 double Matrix::get(int i, int j) const
 {
-    return 0.0; // TODO
+    return data[static_cast<size_t>(i) * cols + j];
 }
 
 void Matrix::set(int i, int j, double value)
 {
-    // TODO
+    data[static_cast<size_t>(i) * cols + j] = value;
+}
+
+double *Matrix::rawData()
+{
+    return data.data();
+}
+
+const double *Matrix::rawData() const
+{
+    return data.data();
+}
+
+const char *Matrix::kernelISA()
+{
+    return kernels().isa;
+}
+
+bool Matrix::useKernelISA(const std::string &isa)
+{
+    const KernelTable *table = findTable(isa);
+    if (!table)
+        return false;
+    activeKernels() = table;
+    return true;
+}
+
+Matrix::GemmTuning Matrix::gemmTuning()
+{
+    return activeTuning();
+}
+
+void Matrix::setGemmTuning(const GemmTuning &tuning)
+{
+    if (!validTuning(tuning))
+        throw std::invalid_argument("Invalid GEMM tuning");
+    setActiveTuning(tuning);
+}
+
+Matrix::GemmTuning Matrix::autotuneGemm(int size)
+{
+    if (size <= 0)
+        throw std::invalid_argument("Autotuning size must be positive");
+    const HostKey host = hostKey();
+    const GemmTuning tuning = searchTuning(size, host);
+    setActiveTuning(tuning);
+    if (!saveTuning(host, tuning))
+        throw std::runtime_error("Cannot write the GEMM tuning file " + tuningFile());
+    return tuning;
+}
+
+std::string Matrix::gemmTuningFile()
+{
+    return tuningFile();
 }
 
 void Matrix::fill(double value)
 {
-    // TODO
+    MATRIX_ZONE("Matrix::fill");
+    double *c = data.data();
+    const KernelTable &kt = kernels();
+    forEachChunk(static_cast<long>(data.size()), [&](long begin, long end) { kt.fill(c + begin, value, end - begin); });
 }
 
 Matrix Matrix::operator+(const Matrix &other) const
 {
-    Matrix result(0, 0);
-    // TODO
+    MATRIX_ZONE("Matrix::operator+");
+    if (rows != other.rows || cols != other.cols)
+        throw std::invalid_argument("Matrix dimensions must match for addition");
+    Matrix result(rows, cols);
+    const double *a = data.data();
+    const double *b = other.data.data();
+    double *c = result.data.data();
+    const KernelTable &kt = kernels();
+    forEachChunk(static_cast<long>(data.size()), [&](long begin, long end) { kt.add(a + begin, b + begin, c + begin, end - begin); });
     return result;
 }
 
 Matrix Matrix::operator-(const Matrix &other) const
 {
-    Matrix result(0, 0);
-    // TODO
+    MATRIX_ZONE("Matrix::operator-");
+    if (rows != other.rows || cols != other.cols)
+        throw std::invalid_argument("Matrix dimensions must match for subtraction");
+    Matrix result(rows, cols);
+    const double *a = data.data();
+    const double *b = other.data.data();
+    double *c = result.data.data();
+    const KernelTable &kt = kernels();
+    forEachChunk(static_cast<long>(data.size()), [&](long begin, long end) { kt.sub(a + begin, b + begin, c + begin, end - begin); });
     return result;
 }
 
 Matrix Matrix::operator*(const Matrix &other) const
 {
-    Matrix result(0, 0);
-    // TODO
+    MATRIX_ZONE("Matrix::operator*(Matrix)");
+    if (cols != other.rows)
+        throw std::invalid_argument("Matrix dimensions are incompatible for multiplication");
+    Matrix result(rows, other.cols);
+    gemm(rows, other.cols, cols, data.data(), other.data.data(), result.data.data(), activeTuning());
     return result;
 }
 
+void Matrix::multiplyAdd(int m, int n, int k, const double *a, const double *b, double *c)
+{
+    MATRIX_ZONE("Matrix::multiplyAdd");
+    if (m < 0 || n < 0 || k < 0)
+        throw std::invalid_argument("Matrix dimensions must be non-negative");
+    gemm(m, n, k, a, b, c, activeTuning());
+}
+
 Matrix Matrix::operator*(double scalar) const
 {
-    Matrix result(0, 0);
-    // TODO
+    MATRIX_ZONE("Matrix::operator*(double)");
+    Matrix result(rows, cols);
+    const double *a = data.data();
+    double *c = result.data.data();
+    const KernelTable &kt = kernels();
+    forEachChunk(static_cast<long>(data.size()), [&](long begin, long end) { kt.scale(a + begin, scalar, c + begin, end - begin); });
     return result;
 }
 
 Matrix Matrix::transpose() const
 {
-    Matrix result(0, 0);
-    // TODO
+    MATRIX_ZONE("Matrix::transpose");
+    Matrix result(cols, rows);
+    const double *a = data.data();
+    double *t = result.data.data();
+    const KernelTable &kt = kernels();
+    // Work on square tiles so that both the reads and the strided writes stay in cache.
+    const int tile = 64;
+#pragma omp parallel for schedule(static) if (static_cast<long>(rows) * cols >= 2 * parallelGrain)
+    for (int ii = 0; ii < rows; ii += tile)
+        for (int jj = 0; jj < cols; jj += tile)
+            kt.transposeTile(a + static_cast<long>(ii) * cols + jj, cols, t + static_cast<long>(jj) * rows + ii, rows,
+                             std::min(tile, rows - ii), std::min(tile, cols - jj));
     return result;
 }
 
 Matrix Matrix::apply(const std::function<double(double)> &func) const
 {
-    Matrix result(0, 0);
-    // TODO
+    MATRIX_ZONE("Matrix::apply");
+    Matrix result(rows, cols);
+    const long n = static_cast<long>(data.size());
+    const double *a = data.data();
+    double *c = result.data.data();
+#pragma omp parallel for schedule(static)
+    for (long k = 0; k < n; ++k)
+        c[k] = func(a[k]);
     return result;
 }
 
 void Matrix::sub_mul(double scalar, const Matrix &other)
 {
-    // TODO
+    MATRIX_ZONE("Matrix::sub_mul");
+    if (rows != other.rows || cols != other.cols)
+        throw std::invalid_argument("Matrix dimensions must match for sub_mul");
+    double *a = data.data();
+    const double *b = other.data.data();
+    const KernelTable &kt = kernels();
+    forEachChunk(static_cast<long>(data.size()), [&](long begin, long end) { kt.subMul(a + begin, scalar, b + begin, end - begin); });
+}
+
+double Matrix::sum() const
+{
+    MATRIX_ZONE("Matrix::sum");
+    const double *a = data.data();
+    const KernelTable &kt = kernels();
+    double total = 0.0;
+#pragma omp parallel reduction(+ : total) if (static_cast<long>(data.size()) >= 2 * parallelGrain)
+    {
+        long begin = 0, end = static_cast<long>(data.size());
+#ifdef _OPENMP
+        const long n = end, thread = omp_get_thread_num(), numThreads = omp_get_num_threads();
+        begin = n * thread / numThreads;
+        end = n * (thread + 1) / numThreads;
+#endif
+        total += kt.sum(a + begin, end - begin);
+    }
+    return total;
 }
@@ -35,7 +35,9 @@ cl::Program loadAndBuildProgram(cl::Context context,
 
 const std::string kernel_source_fill = R"(
     __kernel void fill(__global float* matrix, float value, int rows, int cols) {
-        // TODO
+        int idx = get_global_id(0);
+        if (idx < rows * cols)
+            matrix[idx] = value;
     }
 )";
 
@@ -44,7 +46,9 @@ const std::string kernel_source_add = R"(
                       __global const float* B,
                       __global float* C,
                       int rows, int cols) {
-        // TODO
+        int idx = get_global_id(0);
+        if (idx < rows * cols)
+            C[idx] = A[idx] + B[idx];
     }
 )";
 
@@ -53,7 +57,9 @@ const std::string kernel_source_sub_mul = R"(
                           __global const float* B,
                           float scalar,
                           int rows, int cols) {
-        // TODO
+        int idx = get_global_id(0);
+        if (idx < rows * cols)
+            A[idx] -= scalar * B[idx];
     }
 )";
 
@@ -61,7 +67,10 @@ const std::string kernel_source_transpose = R"(
     __kernel void transpose(__global const float* A,
                             __global float* B,
                             int A_rows, int A_cols) {
-        // TODO
+        int row = get_global_id(0);
+        int col = get_global_id(1);
+        if (row < A_rows && col < A_cols)
+            B[col * A_rows + row] = A[row * A_cols + col];
     }
 )";
 
@@ -70,7 +79,14 @@ const std::string kernel_source_matrix_mul = R"(
                              __global const float* B,
                              __global float* C,
                              int A_rows, int A_cols, int B_cols) {
-        // TODO
+        int row = get_global_id(0);
+        int col = get_global_id(1);
+        if (row < A_rows && col < B_cols) {
+            float acc = 0.0f;
+            for (int k = 0; k < A_cols; k++)
+                acc += A[row * A_cols + k] * B[k * B_cols + col];
+            C[row * B_cols + col] = acc;
+        }
     }
 )";
 
@@ -133,21 +149,45 @@ size_t MatrixCL::buffer_size_bytes() const {
 MatrixCL::MatrixCL(int rows, int cols, cl::Context context, cl::CommandQueue queue, const std::vector<float>* initial_data)
     : rows_(rows), cols_(cols), context_(context), queue_(queue)
 {
-    // TODO
+    if (rows < 0 || cols < 0)
+        throw std::invalid_argument("MatrixCL dimensions must be non-negative");
+    size_t size = buffer_size_bytes();
+    if (size == 0) return;
+
+    buffer_ = cl::Buffer(context_, CL_MEM_READ_WRITE, size);
+    if (initial_data) {
+        if (initial_data->size() != static_cast<size_t>(rows_) * cols_)
+            throw std::invalid_argument("Initial data size does not match MatrixCL dimensions");
+        queue_.enqueueWriteBuffer(buffer_, CL_TRUE, 0, size, initial_data->data());
+    }
 }
 
 MatrixCL::MatrixCL(const MatrixCL& other)
     : rows_(other.rows_), cols_(other.cols_),
       context_(other.context_), queue_(other.queue_)
 {
-    // TODO
+    size_t size = buffer_size_bytes();
+    if (size == 0) return;
+
+    buffer_ = cl::Buffer(context_, CL_MEM_READ_WRITE, size);
+    queue_.enqueueCopyBuffer(other.buffer_, buffer_, 0, 0, size);
 }
 
 MatrixCL& MatrixCL::operator=(const MatrixCL& other)
 {
     if (this == &other) return *this;
 
-    // TODO
+    rows_ = other.rows_;
+    cols_ = other.cols_;
+    context_ = other.context_;
+    queue_ = other.queue_;
+    size_t size = buffer_size_bytes();
+    if (size == 0) {
+        buffer_ = cl::Buffer();
+        return *this;
+    }
+    buffer_ = cl::Buffer(context_, CL_MEM_READ_WRITE, size);
+    queue_.enqueueCopyBuffer(other.buffer_, buffer_, 0, 0, size);
 
     return *this;
 }
@@ -164,7 +204,8 @@ std::vector<float> MatrixCL::copyToHost() const
     size_t size = buffer_size_bytes();
     if (size == 0) return host_data;
 
-    // TODO
+    // Blocking read: also waits for every kernel previously enqueued on this buffer
+    queue_.enqueueReadBuffer(buffer_, CL_TRUE, 0, size, host_data.data());
 
     return host_data;
 }
@@ -173,7 +214,12 @@ void MatrixCL::fill(float value)
 {
     if (rows_ * cols_ == 0) return;
 
-    // TODO
+    cl::Kernel& kernel = kernels_->kernel_fill;
+    kernel.setArg(0, buffer_);
+    kernel.setArg(1, value);
+    kernel.setArg(2, rows_);
+    kernel.setArg(3, cols_);
+    queue_.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(static_cast<size_t>(rows_) * cols_));
 }
 
 MatrixCL MatrixCL::operator+(const MatrixCL& other) const
@@ -181,7 +227,15 @@ MatrixCL MatrixCL::operator+(const MatrixCL& other) const
     MatrixCL result(rows_, cols_, context_, queue_);
     if (rows_ * cols_ == 0) return result;
 
-    // TODO
+    if (rows_ != other.rows_ || cols_ != other.cols_)
+        throw std::invalid_argument("MatrixCL dimensions must match for addition");
+    cl::Kernel& kernel = kernels_->kernel_add;
+    kernel.setArg(0, buffer_);
+    kernel.setArg(1, other.buffer_);
+    kernel.setArg(2, result.buffer_);
+    kernel.setArg(3, rows_);
+    kernel.setArg(4, cols_);
+    queue_.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(static_cast<size_t>(rows_) * cols_));
 
     return result;
 }
@@ -191,7 +245,8 @@ MatrixCL MatrixCL::operator-(const MatrixCL& other) const
     MatrixCL result(*this);
     if (rows_ * cols_ == 0) return result;
 
-    // TODO
+    // this - other = this - 1 * other
+    result.sub_mul(1.0f, other);
 
     return result;
 }
@@ -201,7 +256,9 @@ MatrixCL MatrixCL::operator*(float scalar) const
     MatrixCL result(rows_, cols_, context_, queue_);
     if (rows_ * cols_ == 0) return result;
 
-    // TODO
+    // scalar * this = 0 - (-scalar) * this
+    result.fill(0.0f);
+    result.sub_mul(-scalar, *this);
 
     return result;
 }
@@ -213,7 +270,16 @@ MatrixCL MatrixCL::operator*(const MatrixCL& other) const
     MatrixCL result(C_rows, C_cols, context_, queue_);
     if (C_rows * C_cols == 0) return result;
 
-    // TODO
+    if (cols_ != other.rows_)
+        throw std::invalid_argument("MatrixCL dimensions are incompatible for multiplication");
+    cl::Kernel& kernel = kernels_->kernel_matrix_mul;
+    kernel.setArg(0, buffer_);
+    kernel.setArg(1, other.buffer_);
+    kernel.setArg(2, result.buffer_);
+    kernel.setArg(3, rows_);
+    kernel.setArg(4, cols_);
+    kernel.setArg(5, other.cols_);
+    queue_.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(C_rows, C_cols));
 
     return result;
 }
@@ -223,7 +289,12 @@ MatrixCL MatrixCL::transpose() const
     MatrixCL result(cols_, rows_, context_, queue_);
     if (rows_ * cols_ == 0) return result;
 
-    // TODO
+    cl::Kernel& kernel = kernels_->kernel_transpose;
+    kernel.setArg(0, buffer_);
+    kernel.setArg(1, result.buffer_);
+    kernel.setArg(2, rows_);
+    kernel.setArg(3, cols_);
+    queue_.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(rows_, cols_));
 
     return result;
 }
@@ -232,5 +303,13 @@ void MatrixCL::sub_mul(float scalar, const MatrixCL& other)
 {
     if (rows_ * cols_ == 0) return;
 
-    // TODO
+    if (rows_ != other.rows_ || cols_ != other.cols_)
+        throw std::invalid_argument("MatrixCL dimensions must match for sub_mul");
+    cl::Kernel& kernel = kernels_->kernel_sub_mul;
+    kernel.setArg(0, buffer_);
+    kernel.setArg(1, other.buffer_);
+    kernel.setArg(2, scalar);
+    kernel.setArg(3, rows_);
+    kernel.setArg(4, cols_);
+    queue_.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(static_cast<size_t>(rows_) * cols_));
 }
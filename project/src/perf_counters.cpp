@@ -0,0 +1,196 @@
+#include "perf_counters.hpp"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+double now()
+{
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+uint64_t cacheEvent(uint64_t cache, uint64_t op, uint64_t result)
+{
+    return cache | (op << 8) | (result << 16);
+}
+
+// Generic hardware events plus the model-specific floating-point events:
+//  - Intel (Skylake and later): FP_ARITH_INST_RETIRED (event 0xC7), scalar double (umask 0x01)
+//    and packed double of any width (umasks 0x04 | 0x10 | 0x40). An FMA instruction counts twice.
+//  - AMD (Zen): FP_RET_SSE_AVX_OPS (event 0x03, umask 0xFF), retired flops (an FMA counts 2).
+std::vector<PerfCounters::Event> candidateEvents()
+{
+    std::vector<PerfCounters::Event> events = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"L1d_misses", PERF_TYPE_HW_CACHE,
+         cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {"LLC_misses", PERF_TYPE_HW_CACHE,
+         cacheEvent(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    };
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_is("intel")) {
+        events.push_back({"fp_scalar_double", PERF_TYPE_RAW, 0x01C7});
+        events.push_back({"fp_vector_double", PERF_TYPE_RAW, 0x54C7});
+    } else if (__builtin_cpu_is("amd")) {
+        events.push_back({"fp_ops", PERF_TYPE_RAW, 0xFF03});
+    }
+#endif
+    // Software events are always available (e.g. in virtual machines without a virtual PMU):
+    // CPU time summed over the threads, to compare with the elapsed time, and page faults.
+    events.push_back({"task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK});
+    events.push_back({"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS});
+    return events;
+}
+
+// Counts `event` for the calling thread, in user space only. Returns -1 if not supported.
+int openCounter(const PerfCounters::Event &event)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // The PMU may have fewer counters than events: the kernel then multiplexes them and
+    // these times let us scale the counts to the whole duration.
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1 /* any cpu */, -1, 0));
+}
+
+double readCounter(int fd)
+{
+    uint64_t values[3] = {0, 0, 0}; // value, time enabled, time running
+    if (::read(fd, values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)) || values[2] == 0)
+        return 0.0;
+    return static_cast<double>(values[0]) * values[1] / values[2];
+}
+
+} // namespace
+
+PerfCounters::PerfCounters()
+{
+    // Keep the events that can be opened on the calling thread
+    for (const Event &event : candidateEvents()) {
+        int fd = openCounter(event);
+        if (fd >= 0) {
+            close(fd);
+            events_.push_back(event);
+        }
+    }
+
+    int numThreads = 1;
+#ifdef _OPENMP
+    numThreads = omp_get_max_threads();
+#endif
+    fds_.assign(numThreads, std::vector<int>(events_.size(), -1));
+    // A counter only counts the thread that opened it, so every thread of the pool opens its own.
+#pragma omp parallel num_threads(numThreads)
+    {
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        for (size_t e = 0; e < events_.size(); e++)
+            fds_[thread][e] = openCounter(events_[e]);
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    instrumentation::removeListener(this);
+    for (const auto &threadFds : fds_)
+        for (int fd : threadFds)
+            if (fd >= 0)
+                close(fd);
+}
+
+const std::vector<PerfCounters::Event> &PerfCounters::events() const
+{
+    return events_;
+}
+
+bool PerfCounters::available() const
+{
+    return !events_.empty();
+}
+
+std::vector<double> PerfCounters::read() const
+{
+    std::vector<double> totals(events_.size(), 0.0);
+    for (const auto &threadFds : fds_)
+        for (size_t e = 0; e < threadFds.size(); e++)
+            if (threadFds[e] >= 0)
+                totals[e] += readCounter(threadFds[e]);
+    return totals;
+}
+
+void PerfCounters::enterZone(const char *name)
+{
+    stack_.push_back({name, now(), read()});
+}
+
+void PerfCounters::exitZone(const char *name)
+{
+    std::vector<double> counts = read();
+    double end = now();
+    if (stack_.empty() || stack_.back().name != name)
+        return; // Unbalanced zones (listener attached in the middle of a zone)
+    OpenZone zone = stack_.back();
+    stack_.pop_back();
+
+    ZoneStats &stats = zones_[zone.name];
+    stats.counts.resize(events_.size(), 0.0);
+    stats.calls++;
+    stats.seconds += end - zone.start;
+    for (size_t e = 0; e < events_.size(); e++)
+        stats.counts[e] += counts[e] - zone.counts[e];
+}
+
+const std::map<std::string, PerfCounters::ZoneStats> &PerfCounters::zones() const
+{
+    return zones_;
+}
+
+void PerfCounters::report(std::ostream &out) const
+{
+    if (!available()) {
+        out << "No hardware counter available (check /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+        return;
+    }
+    int cycles = -1, instructions = -1;
+    for (size_t e = 0; e < events_.size(); e++) {
+        if (events_[e].name == "cycles")
+            cycles = static_cast<int>(e);
+        if (events_[e].name == "instructions")
+            instructions = static_cast<int>(e);
+    }
+
+    out << std::left << std::setw(38) << "zone" << std::right << std::setw(8) << "calls" << std::setw(12) << "time (s)";
+    for (const Event &event : events_)
+        out << std::setw(18) << event.name;
+    if (cycles >= 0 && instructions >= 0)
+        out << std::setw(8) << "IPC";
+    out << std::endl;
+
+    for (const auto &entry : zones_) {
+        const ZoneStats &stats = entry.second;
+        out << std::left << std::setw(38) << entry.first << std::right << std::setw(8) << stats.calls
+            << std::setw(12) << std::setprecision(4) << stats.seconds;
+        for (double count : stats.counts)
+            out << std::setw(18) << std::setprecision(6) << count;
+        if (cycles >= 0 && instructions >= 0)
+            out << std::setw(8) << std::setprecision(3)
+                << (stats.counts[cycles] > 0 ? stats.counts[instructions] / stats.counts[cycles] : 0.0);
+        out << std::endl;
+    }
+}
@@ -2,9 +2,14 @@
 #include "matrix.hpp"
 #include <mpi.h>
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <functional>
+#include <stdexcept>
 
 bool approxEqual(double a, double b, double epsilon = 1e-10) {
     return std::abs(a - b) < epsilon;
@@ -123,6 +128,62 @@ void testApplyBinary() {
         std::cout << "testApplyBinary passed." << std::endl;
 }
 
+void testInPlaceElementwise() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    // Large enough for the threaded loop on a few processes
+    Matrix w(200, 230);
+    Matrix g(200, 230);
+    for (int i = 0; i < 200; i++) {
+        for (int j = 0; j < 230; j++) {
+            w.set(i, j, 0.01 * (i - j));
+            g.set(i, j, 0.02 * ((i * 7 + j * 3) % 11) - 0.1);
+        }
+    }
+    auto tanhFunc = [](double x) { return std::tanh(x); };
+    auto mulFunc = [](double a, double b) { return a * b; };
+
+    for (DistributedMatrix::Layout layout : {DistributedMatrix::Layout::Columns, DistributedMatrix::Layout::BlockCyclic}) {
+        DistributedMatrix distW(w, numProcs, layout, 16);
+        DistributedMatrix distG(g, numProcs, layout, 16);
+
+        DistributedMatrix applied(distW);
+        applied.applyInPlace(tanhFunc);
+        assert(matricesEqual(applied.getLocalData(), distW.apply(tanhFunc).getLocalData(), 1e-15));
+
+        DistributedMatrix product(distW);
+        product.applyBinaryInPlace(distG, mulFunc);
+        assert(matricesEqual(product.getLocalData(),
+                             DistributedMatrix::applyBinary(distW, distG, mulFunc).getLocalData(), 1e-15));
+
+        // The fused update step against sub_mul of a temporary
+        DistributedMatrix expected(distW);
+        expected.sub_mul(0.5, distG.apply(tanhFunc));
+        DistributedMatrix updated(distW);
+        updated.axpby(-0.5, distG, 1.0, tanhFunc);
+        assert(matricesEqual(updated.gather(), expected.gather(), 1e-14));
+
+        DistributedMatrix combined(distW);
+        combined.axpby(2.0, distG, -3.0);
+        assert(matricesEqual(combined.gather(), g * 2.0 - w * 3.0, 1e-14));
+    }
+
+    DistributedMatrix distW(w, numProcs);
+    DistributedMatrix other(Matrix(200, 100), numProcs);
+    bool threw = false;
+    try {
+        distW.axpby(1.0, other, 1.0);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    if (rank == 0)
+        std::cout << "testInPlaceElementwise passed." << std::endl;
+}
+
 void testMultiply() {
     int rank, numProcs;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -169,10 +230,59 @@ void testMultiplyTransposed() {
     Matrix expected = matrix1Full * matrix2Full.transpose();
     assert(matricesEqual(result, expected, 1e-8));
 
+    // Large enough to be reduced in several row blocks
+    Matrix tallFull(300, 7), wideFull(200, 7);
+    for (int i = 0; i < 300; i++)
+        for (int j = 0; j < 7; j++)
+            tallFull.set(i, j, std::sin(i + 0.5 * j));
+    for (int i = 0; i < 200; i++)
+        for (int j = 0; j < 7; j++)
+            wideFull.set(i, j, std::cos(0.3 * i - j));
+    Matrix tallExpected = tallFull * wideFull.transpose();
+    DistributedMatrix tall(tallFull, numProcs), wide(wideFull, numProcs);
+    assert(matricesEqual(tall.multiplyTransposed(wide), tallExpected, 1e-8));
+    DistributedMatrix tall2D(tallFull, numProcs, DistributedMatrix::Layout::BlockCyclic, 16);
+    DistributedMatrix wide2D(wideFull, numProcs, DistributedMatrix::Layout::BlockCyclic, 16);
+    assert(matricesEqual(tall2D.multiplyTransposed(wide2D), tallExpected, 1e-8));
+
     if (rank == 0)
         std::cout << "testMultiplyTransposed passed." << std::endl;
 }
 
+void testMultiplyTransposedDistributed() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    Matrix matrix1Full(6, 5);
+    Matrix matrix2Full(numProcs * 2 + 1, 5);
+    for (int i = 0; i < matrix1Full.numRows(); i++)
+        for (int j = 0; j < 5; j++)
+            matrix1Full.set(i, j, i * 5 + j + 1);
+    for (int i = 0; i < matrix2Full.numRows(); i++)
+        for (int j = 0; j < 5; j++)
+            matrix2Full.set(i, j, i - 2.0 * j);
+    Matrix expected = matrix1Full * matrix2Full.transpose();
+
+    DistributedMatrix matrix1(matrix1Full, numProcs), matrix2(matrix2Full, numProcs);
+    DistributedMatrix result = matrix1.multiplyTransposedDistributed(matrix2);
+    assert(result.numRows() == expected.numRows() && result.numCols() == expected.numCols());
+    // Same column distribution as a DistributedMatrix built from the full result
+    assert(result.getLocalData().numCols() == DistributedMatrix(expected, numProcs).getLocalData().numCols());
+    assert(matricesEqual(result.gather(), expected, 1e-8));
+
+    for (int block : {1, 2}) {
+        DistributedMatrix a(matrix1Full, numProcs, DistributedMatrix::Layout::BlockCyclic, block);
+        DistributedMatrix b(matrix2Full, numProcs, DistributedMatrix::Layout::BlockCyclic, block);
+        DistributedMatrix c = a.multiplyTransposedDistributed(b);
+        assert(c.getRowDistribution() == a.getRowDistribution());
+        assert(matricesEqual(c.gather(), expected, 1e-8));
+    }
+
+    if (rank == 0)
+        std::cout << "testMultiplyTransposedDistributed passed." << std::endl;
+}
+
 void testSum() {
     int rank, numProcs;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -212,6 +322,382 @@ void testGather() {
         std::cout << "testGather passed." << std::endl;
 }
 
+void testGatherTo() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    Matrix testMatrix(37, 23);
+    for (int i = 0; i < 37; i++)
+        for (int j = 0; j < 23; j++)
+            testMatrix.set(i, j, i * 100 + j);
+
+    for (auto layout : {DistributedMatrix::Layout::Columns, DistributedMatrix::Layout::BlockCyclic}) {
+        DistributedMatrix distMatrix(testMatrix, numProcs, layout, 5);
+        for (int root = 0; root < numProcs; root++) {
+            Matrix gathered = distMatrix.gatherTo(root);
+            if (rank == root)
+                assert(matricesEqual(gathered, testMatrix));
+            else
+                assert(gathered.numRows() == 0 && gathered.numCols() == 0);
+        }
+    }
+
+    bool thrown = false;
+    try {
+        DistributedMatrix(testMatrix, numProcs).gatherTo(numProcs);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    if (rank == 0)
+        std::cout << "testGatherTo passed." << std::endl;
+}
+
+void testWriteCollective() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    const std::string file = "test_distributed_matrix.bin";
+    for (auto layout : {DistributedMatrix::Layout::Columns, DistributedMatrix::Layout::BlockCyclic}) {
+        Matrix testMatrix(29, 41);
+        for (int i = 0; i < 29; i++)
+            for (int j = 0; j < 41; j++)
+                testMatrix.set(i, j, i * 0.5 - j);
+        DistributedMatrix(testMatrix, numProcs, layout, 4).writeCollective(file);
+
+        if (rank == 0) {
+            // Header with the dimensions, then the elements in row-major order
+            std::ifstream in(file, std::ios::binary);
+            int64_t dims[2];
+            in.read(reinterpret_cast<char*>(dims), sizeof(dims));
+            assert(dims[0] == 29 && dims[1] == 41);
+            Matrix read(29, 41);
+            in.read(reinterpret_cast<char*>(read.rawData()), 29 * 41 * sizeof(double));
+            assert(in.gcount() == static_cast<std::streamsize>(29 * 41 * sizeof(double)));
+            assert(in.peek() == std::ifstream::traits_type::eof());
+            assert(matricesEqual(read, testMatrix, 1e-15));
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+    if (rank == 0)
+        std::remove(file.c_str());
+
+    bool thrown = false;
+    try {
+        DistributedMatrix(Matrix(2, 2), numProcs).writeCollective("no_such_directory/matrix.bin");
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    if (rank == 0)
+        std::cout << "testWriteCollective passed." << std::endl;
+}
+
+void testReadCollective() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    const std::string file = "test_distributed_matrix.bin";
+    Matrix testMatrix(33, 19);
+    for (int i = 0; i < 33; i++)
+        for (int j = 0; j < 19; j++)
+            testMatrix.set(i, j, i * 19 + j + 0.25);
+    DistributedMatrix(testMatrix, numProcs).writeCollective(file);
+
+    // Read back with any layout, independently of the one that wrote the file
+    for (auto layout : {DistributedMatrix::Layout::Columns, DistributedMatrix::Layout::BlockCyclic}) {
+        DistributedMatrix read(file, numProcs, layout, 4);
+        DistributedMatrix expected(testMatrix, numProcs, layout, 4);
+        assert(read.numRows() == 33 && read.numCols() == 19);
+        assert(read.getRowDistribution() == expected.getRowDistribution());
+        assert(read.getColDistribution() == expected.getColDistribution());
+        assert(matricesEqual(read.getLocalData(), expected.getLocalData(), 1e-15));
+    }
+
+    // Truncated file
+    if (rank == 0) {
+        std::ofstream out(file, std::ios::binary);
+        int64_t dims[2] = {33, 19};
+        out.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    bool thrown = false;
+    try {
+        DistributedMatrix read(file, numProcs);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0)
+        std::remove(file.c_str());
+
+    thrown = false;
+    try {
+        DistributedMatrix read("no_such_file.bin", numProcs);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    if (rank == 0)
+        std::cout << "testReadCollective passed." << std::endl;
+}
+
+void testPartitioners() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    assert((EqualPartitioner().partition(10, 3) == std::vector<int>{4, 3, 3}));
+    assert((WeightedPartitioner({1.0, 3.0}).partition(8, 2) == std::vector<int>{2, 6}));
+    assert((WeightedPartitioner({1.0, 1.0, 4.0}).partition(2, 3) == std::vector<int>{0, 1, 1}));
+    // Expensive first columns: fewer of them for the first process
+    assert((CostPartitioner({4, 4, 1, 1, 1, 1, 1, 1, 1, 1}).partition(10, 2) == std::vector<int>{2, 8}));
+    assert((CostPartitioner({4, 4, 1, 1, 1, 1, 1, 1, 1, 1}, {1.0, 2.0}).partition(10, 2) == std::vector<int>{1, 9}));
+    assert((CostPartitioner(std::vector<double>(6, 0.0)).partition(6, 3) == std::vector<int>{2, 2, 2}));
+    bool thrown = false;
+    try {
+        WeightedPartitioner({1.0, 0.0});
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    const int rows = 9, cols = 31;
+    Matrix a(rows, cols), b(rows, cols), left(5, rows);
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++) {
+            a.set(i, j, i + 0.1 * j);
+            b.set(i, j, 0.5 * i - j);
+        }
+    for (int i = 0; i < 5; i++)
+        for (int k = 0; k < rows; k++)
+            left.set(i, k, i - k);
+
+    // The faster a process, the more columns it owns
+    std::vector<double> speeds(numProcs);
+    for (int p = 0; p < numProcs; p++)
+        speeds[p] = p + 1.0;
+    WeightedPartitioner weighted(speeds);
+    std::vector<int> sizes = weighted.partition(cols, numProcs);
+    DistributedMatrix distA(a, numProcs, weighted), distB(b, numProcs, weighted);
+    assert(distA.getLocalData().numCols() == sizes[rank]);
+    assert(matricesEqual(distA.gather(), a));
+    assert(matricesEqual(distA.transpose(), a.transpose()));
+    assert(approxEqual(distA.sum(), a.sum(), 1e-9));
+    assert(matricesEqual((distA + distB).gather(), a + b));
+    assert(matricesEqual(multiply(left, distA).gather(), left * a));
+    assert(matricesEqual(distA.multiplyTransposed(distB), a * b.transpose(), 1e-9));
+    for (int j = 0; j < cols; j++)
+        if (distA.ownerProcess(j) == rank)
+            assert(distA.get(rows - 1, j) == a.get(rows - 1, j));
+
+    // Runtime repartitioning gives the same local blocks as a direct construction
+    DistributedMatrix moved(a, numProcs);
+    moved.repartition(weighted);
+    assert(moved.getColDistribution() == distA.getColDistribution());
+    assert(matricesEqual(moved.getLocalData(), distA.getLocalData(), 1e-15));
+    std::vector<double> costs(cols);
+    for (int j = 0; j < cols; j++)
+        costs[j] = j % 7 + 1.0;
+    CostPartitioner byCost(costs);
+    moved.repartition(byCost);
+    assert(matricesEqual(moved.getLocalData(), DistributedMatrix(a, numProcs, byCost).getLocalData(), 1e-15));
+    moved.repartition(EqualPartitioner());
+    assert(moved.getColDistribution() == DistributedMatrix(a, numProcs).getColDistribution());
+    assert(matricesEqual(moved.getLocalData(), DistributedMatrix(a, numProcs).getLocalData(), 1e-15));
+
+    // Measured speeds: process p took p + 1 times longer per column
+    DistributedMatrix timed(a, numProcs);
+    WeightedPartitioner measured = WeightedPartitioner::measured(timed, (rank + 1.0) * timed.getLocalData().numCols());
+    for (int p = 0; p < numProcs; p++)
+        assert(approxEqual(measured.getSpeeds()[p] * (p + 1), measured.getSpeeds()[0]));
+
+    thrown = false;
+    try {
+        DistributedMatrix(a, numProcs, DistributedMatrix::Layout::BlockCyclic, 4).repartition(weighted);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown || numProcs == 1);
+
+    if (rank == 0)
+        std::cout << "testPartitioners passed." << std::endl;
+}
+
+void testNodeShared() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    Matrix left(6, 11), a(11, 13), b(7, 13);
+    for (int i = 0; i < 6; i++)
+        for (int k = 0; k < 11; k++)
+            left.set(i, k, i * 11 + k - 30.0);
+    for (int i = 0; i < 11; i++)
+        for (int j = 0; j < 13; j++)
+            a.set(i, j, 0.5 * i - j);
+    for (int i = 0; i < 7; i++)
+        for (int j = 0; j < 13; j++)
+            b.set(i, j, i + 0.25 * j);
+
+    // Only the source needs the matrix
+    const int src = numProcs - 1;
+    NodeSharedMatrix shared(rank == src ? left : Matrix(0, 0), src);
+    assert(shared.numRows() == 6 && shared.numCols() == 11);
+    assert(matricesEqual(shared.toMatrix(), left, 1e-15));
+    assert(shared.get(5, 10) == left.get(5, 10));
+    NodeSharedMatrix copy(shared);
+    assert(copy.rawData() == shared.rawData());
+
+    for (auto layout : {DistributedMatrix::Layout::Columns, DistributedMatrix::Layout::BlockCyclic}) {
+        DistributedMatrix distA(a, numProcs, layout, 3);
+        assert(matricesEqual(multiply(shared, distA).gather(), left * a));
+
+        DistributedMatrix distB(b, numProcs, layout, 3);
+        NodeSharedMatrix product = distA.multiplyTransposedShared(distB);
+        assert(matricesEqual(product.toMatrix(), a * b.transpose(), 1e-9));
+    }
+
+    if (rank == 0)
+        std::cout << "testNodeShared passed." << std::endl;
+}
+
+void testRowLayout() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    Matrix a(23, 9), b(23, 9), left(4, 23);
+    for (int i = 0; i < 23; i++)
+        for (int j = 0; j < 9; j++) {
+            a.set(i, j, i - 2.0 * j);
+            b.set(i, j, 0.5 * i * j);
+        }
+    for (int i = 0; i < 4; i++)
+        for (int k = 0; k < 23; k++)
+            left.set(i, k, i + k);
+
+    DistributedMatrix distA(a, numProcs, DistributedMatrix::Layout::Rows);
+    DistributedMatrix distB(b, numProcs, DistributedMatrix::Layout::Rows);
+    assert(distA.getGrid().rows == numProcs && distA.getGrid().cols == 1);
+    assert(distA.getLocalData().numCols() == 9);
+    assert(matricesEqual(distA.gather(), a));
+    assert(matricesEqual(distA.transpose(), a.transpose()));
+    assert(matricesEqual((distA + distB).gather(), a + b));
+    assert(matricesEqual(multiply(left, distA).gather(), left * a));
+    assert(matricesEqual(distA.multiplyTransposed(distB), a * b.transpose(), 1e-9));
+
+    if (rank == 0)
+        std::cout << "testRowLayout passed." << std::endl;
+}
+
+void testTSQR() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    // Tall and skinny, then fewer rows per process than columns
+    const int cols = 5;
+    for (int rows : {200, std::max(cols, 2 * numProcs + 1)}) {
+        Matrix a(rows, cols);
+        unsigned seed = 7;
+        for (int i = 0; i < rows; i++)
+            for (int j = 0; j < cols; j++) {
+                seed = seed * 1103515245u + 12345u;
+                a.set(i, j, (seed >> 16) / 65536.0 - 0.5);
+            }
+        DistributedMatrix distA(a, numProcs, DistributedMatrix::Layout::Rows);
+        std::pair<DistributedMatrix, Matrix> qr = distA.tsqr();
+        Matrix q = qr.first.gather();
+        const Matrix& r = qr.second;
+
+        assert(r.numRows() == cols && r.numCols() == cols);
+        for (int i = 0; i < cols; i++) {
+            assert(r.get(i, i) >= 0.0);
+            for (int j = 0; j < i; j++)
+                assert(r.get(i, j) == 0.0);
+        }
+        assert(matricesEqual(q * r, a, 1e-12));
+        Matrix identity(cols, cols);
+        for (int i = 0; i < cols; i++)
+            identity.set(i, i, 1.0);
+        assert(matricesEqual(q.transpose() * q, identity, 1e-12));
+        assert(qr.first.getRowDistribution() == distA.getRowDistribution());
+    }
+
+    bool thrown = false;
+    try {
+        DistributedMatrix(Matrix(8, 2), numProcs).tsqr();
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown || numProcs == 1);
+
+    if (rank == 0)
+        std::cout << "testTSQR passed." << std::endl;
+}
+
+void testAsyncCheckpoint() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    const std::string file = "test_checkpoint.bin";
+    Matrix testMatrix(23, 17);
+    for (int i = 0; i < 23; i++)
+        for (int j = 0; j < 17; j++)
+            testMatrix.set(i, j, i * 17 + j + 0.5);
+
+    // Written from every layout, restarted in another one
+    for (auto layout : {DistributedMatrix::Layout::Columns, DistributedMatrix::Layout::BlockCyclic,
+                        DistributedMatrix::Layout::Rows}) {
+        DistributedMatrix matrix(testMatrix, numProcs, layout, 4);
+        AsyncCheckpoint checkpoint(matrix, file);
+        matrix.fill(-1.0); // The checkpoint holds the values at its start
+        checkpoint.commit();
+        assert(checkpoint.written());
+
+        auto restartLayout = layout == DistributedMatrix::Layout::Columns ? DistributedMatrix::Layout::BlockCyclic
+                                                                          : DistributedMatrix::Layout::Columns;
+        DistributedMatrix restarted(file, numProcs, restartLayout, 3);
+        assert(matricesEqual(restarted.gather(), testMatrix, 1e-15));
+    }
+
+    // Without a commit, the previous checkpoint stays in place
+    {
+        DistributedMatrix other(testMatrix * 2.0, numProcs);
+        AsyncCheckpoint unfinished(other, file);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    assert(matricesEqual(DistributedMatrix(file, numProcs).gather(), testMatrix, 1e-15));
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0) {
+        std::remove(file.c_str());
+        std::remove((file + ".partial").c_str());
+    }
+
+    // A process that cannot write makes the commit fail on all of them
+    DistributedMatrix matrix(testMatrix, numProcs);
+    AsyncCheckpoint failing(matrix, "no_such_directory/checkpoint.bin");
+    bool thrown = false;
+    try {
+        failing.commit();
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    if (rank == 0)
+        std::cout << "testAsyncCheckpoint passed." << std::endl;
+}
+
 void testGetAndSet() {
     int rank, numProcs;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -254,6 +740,81 @@ void testGetAndSet() {
         std::cout << "testGetAndSet passed." << std::endl;
 }
 
+void testRemoteAccess() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    const int rows = 10, cols = 17;
+    Matrix testMatrix(rows, cols);
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++)
+            testMatrix.set(i, j, i * cols + j);
+
+    for (auto layout : {DistributedMatrix::Layout::Columns, DistributedMatrix::Layout::BlockCyclic}) {
+        DistributedMatrix distMatrix(testMatrix, numProcs, layout, 3);
+        distMatrix.beginRemoteAccess();
+        assert(distMatrix.inRemoteAccess());
+
+        // Every element can be read by every process, one by one or in a batch
+        std::vector<std::pair<int, int>> all;
+        for (int i = 0; i < rows; i++)
+            for (int j = 0; j < cols; j++) {
+                assert(distMatrix.get(i, j) == testMatrix.get(i, j));
+                all.push_back({i, j});
+            }
+        all.push_back({0, 0}); // Repeated element
+        std::vector<double> values = distMatrix.getMany(all);
+        for (size_t e = 0; e < all.size(); e++)
+            assert(values[e] == testMatrix.get(all[e].first, all[e].second));
+
+        // Every process adds 1 to every element, and 2 more to (0, 0)
+        MPI_Barrier(MPI_COMM_WORLD);
+        distMatrix.accumulateMany(all, std::vector<double>(all.size(), 1.0));
+        distMatrix.accumulate(0, 0, 1.0);
+        distMatrix.flush();
+        MPI_Barrier(MPI_COMM_WORLD);
+        distMatrix.flush();
+        assert(distMatrix.get(rows - 1, cols - 1) == testMatrix.get(rows - 1, cols - 1) + numProcs);
+
+        bool thrown = false;
+        try {
+            distMatrix = DistributedMatrix(testMatrix, numProcs);
+        } catch (const std::logic_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        thrown = false;
+        try {
+            (void)distMatrix.get(rows, 0);
+        } catch (const std::out_of_range&) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        // Process p sets element (p % rows, (p + 1) % cols), then the epoch ends
+        MPI_Barrier(MPI_COMM_WORLD);
+        distMatrix.set(rank % rows, (rank + 1) % cols, -1.0 - rank);
+        distMatrix.endRemoteAccess();
+        assert(!distMatrix.inRemoteAccess());
+
+        Matrix expected = testMatrix.apply([&](double x) { return x + numProcs; });
+        expected.set(0, 0, expected.get(0, 0) + 2.0 * numProcs);
+        for (int p = 0; p < numProcs; p++)
+            if (p + 1 < cols) // Elements set by a single process
+                expected.set(p % rows, (p + 1) % cols, -1.0 - p);
+        Matrix gathered = distMatrix.gather();
+        for (int p = 0; p < numProcs; p++)
+            if (p + 1 < cols && p < rows)
+                assert(gathered.get(p, p + 1) == expected.get(p, p + 1));
+        assert(gathered.get(0, 0) == expected.get(0, 0) || numProcs >= cols);
+        assert(gathered.get(rows - 1, cols - 1) == expected.get(rows - 1, cols - 1));
+    }
+
+    if (rank == 0)
+        std::cout << "testRemoteAccess passed." << std::endl;
+}
+
 void testCopyConstructor() {
     int rank, numProcs;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -317,11 +878,456 @@ void testCommonOperations() {
         std::cout << "testCommonOperations passed." << std::endl;
 }
 
+void testBlockCyclicLayout() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    const int rows = 7, cols = 9;
+    Matrix full1(rows, cols), full2(rows, cols), left(4, rows), other(5, cols);
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++) {
+            full1.set(i, j, i * cols + j + 1);
+            full2.set(i, j, (i + 2) * (j + 1) * 0.5);
+        }
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < rows; j++)
+            left.set(i, j, i - j * 0.25);
+    for (int i = 0; i < 5; i++)
+        for (int j = 0; j < cols; j++)
+            other.set(i, j, (i + 1) * 0.1 + j);
+
+    for (int block : {1, 2, 3, 64}) {
+        DistributedMatrix dist1(full1, numProcs, DistributedMatrix::Layout::BlockCyclic, block);
+        DistributedMatrix dist2(full2, numProcs, DistributedMatrix::Layout::BlockCyclic, block);
+        const ProcessGrid& grid = dist1.getGrid();
+        assert(grid.rows * grid.cols == numProcs && grid.rows <= grid.cols);
+        assert(rank == grid.myRow * grid.cols + grid.myCol);
+
+        // Every element is stored exactly once, by its owner
+        const Matrix& local = dist1.getLocalData();
+        int stored = local.numRows() * local.numCols(), total = 0;
+        MPI_Allreduce(&stored, &total, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        assert(total == rows * cols);
+        for (int i = 0; i < local.numRows(); i++)
+            for (int j = 0; j < local.numCols(); j++) {
+                int globalI = dist1.globalRowIndex(i), globalJ = dist1.globalColIndex(j);
+                assert(dist1.localRowIndex(globalI) == i && dist1.localColIndex(globalJ) == j);
+                assert(dist1.ownerProcess(globalI, globalJ) == rank);
+                assert(dist1.get(globalI, globalJ) == full1.get(globalI, globalJ));
+            }
+
+        assert(matricesEqual(dist1.gather(), full1));
+        assert(matricesEqual((dist1 + dist2).gather(), full1 + full2));
+        assert(matricesEqual((dist1 - dist2).gather(), full1 - full2));
+        assert(matricesEqual((dist1 * 2.0).gather(), full1 * 2.0));
+        assert(matricesEqual(dist1.transpose(), full1.transpose()));
+        assert(approxEqual(dist1.sum(), full1.sum(), 1e-8));
+        DistributedMatrix updated(dist1);
+        updated.sub_mul(0.5, dist2);
+        Matrix expectedSubMul(full1);
+        expectedSubMul.sub_mul(0.5, full2);
+        assert(matricesEqual(updated.gather(), expectedSubMul));
+
+        assert(matricesEqual(multiply(left, dist1).gather(), left * full1, 1e-8));
+        DistributedMatrix distOther(other, numProcs, DistributedMatrix::Layout::BlockCyclic, block);
+        assert(matricesEqual(dist1.multiplyTransposed(distOther), full1 * other.transpose(), 1e-8));
+
+        // Layout::Auto: 2D when the grid has several rows and every grid row and column a block
+        const ProcessGrid& squarest = dist1.getGrid();
+        bool twoD = squarest.rows > 1 && rows >= squarest.rows * block && cols >= squarest.cols * block;
+        DistributedMatrix automatic(full1, numProcs, DistributedMatrix::Layout::Auto, block);
+        assert(automatic.getLayout() ==
+               (twoD ? DistributedMatrix::Layout::BlockCyclic : DistributedMatrix::Layout::Columns));
+        assert(automatic.getGrid().rows == (twoD ? squarest.rows : 1));
+        assert(matricesEqual(automatic.gather(), full1));
+    }
+
+    if (rank == 0)
+        std::cout << "testBlockCyclicLayout passed." << std::endl;
+}
+
+void testDistributedProduct() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    Matrix fullA(6, 11), fullB(11, 5);
+    for (int i = 0; i < 6; i++)
+        for (int j = 0; j < 11; j++)
+            fullA.set(i, j, i * 0.5 - j + 1);
+    for (int i = 0; i < 11; i++)
+        for (int j = 0; j < 5; j++)
+            fullB.set(i, j, (i + 1) * (j - 2) * 0.25);
+    Matrix expected = fullA * fullB;
+
+    DistributedMatrix columnsA(fullA, numProcs), columnsB(fullB, numProcs);
+    assert(matricesEqual((columnsA * columnsB).gather(), expected, 1e-8));
+
+    // Different block sizes for the two operands give panels that straddle their blocks
+    for (int blockA : {1, 2, 4})
+        for (int blockB : {1, 3}) {
+            DistributedMatrix a(fullA, numProcs, DistributedMatrix::Layout::BlockCyclic, blockA);
+            DistributedMatrix b(fullB, numProcs, DistributedMatrix::Layout::BlockCyclic, blockB);
+            DistributedMatrix c = a * b;
+            assert(c.numRows() == 6 && c.numCols() == 5);
+            assert(c.getRowDistribution() == a.getRowDistribution());
+            assert(matricesEqual(c.gather(), expected, 1e-8));
+        }
+
+    bool threw = false;
+    try { (void)(columnsA * columnsA); }
+    catch (std::invalid_argument&) { threw = true; }
+    assert(threw);
+
+    if (rank == 0)
+        std::cout << "testDistributedProduct passed." << std::endl;
+}
+
+void testRepeatedCollectives() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    // The same shapes many times (cached collectives) and more shapes than the cache holds
+    for (int iteration = 0; iteration < 3; iteration++) {
+        for (int cols = 1; cols <= 80; cols++) {
+            Matrix full(3, cols);
+            for (int i = 0; i < 3; i++)
+                for (int j = 0; j < cols; j++)
+                    full.set(i, j, iteration + i * cols + j);
+            DistributedMatrix dist(full, numProcs);
+            assert(matricesEqual(dist.gather(), full));
+            assert(approxEqual(dist.sum(), full.sum(), 1e-8));
+
+            Matrix synced = rank == 0 ? full : Matrix(1, 1);
+            sync_matrix(&synced, rank, 0);
+            assert(matricesEqual(synced, full));
+        }
+        // Too large for the cached buffers
+        Matrix big(300, 300);
+        big.fill(iteration + 1.0);
+        DistributedMatrix dist(big, numProcs);
+        assert(matricesEqual(dist.gather(), big));
+        Matrix synced = rank == numProcs - 1 ? big : Matrix(2, 2);
+        sync_matrix(&synced, rank, numProcs - 1);
+        assert(matricesEqual(synced, big));
+    }
+
+    if (rank == 0)
+        std::cout << "testRepeatedCollectives passed." << std::endl;
+}
+
+void testCollectiveCachePerCommunicator() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    // Every process is in MPI_COMM_WORLD and in one half: the even half runs more shapes than
+    // the cache holds on its communicator, the odd half a few, so that a cache shared by the
+    // communicators would evict differently on the two halves (and hang on the next collective
+    // setup on MPI_COMM_WORLD that only some of them miss)
+    MPI_Comm half;
+    MPI_Comm_split(MPI_COMM_WORLD, rank % 2, rank, &half);
+    int halfRank, halfSize;
+    MPI_Comm_rank(half, &halfRank);
+    MPI_Comm_size(half, &halfSize);
+    {
+        for (int iteration = 0; iteration < 3; iteration++) {
+            for (int cols = 1; cols <= 40; cols++) {
+                Matrix full(2, cols);
+                for (int j = 0; j < cols; j++) {
+                    full.set(0, j, iteration + j);
+                    full.set(1, j, iteration - j);
+                }
+                Matrix synced = rank == 0 ? full : Matrix(1, 1);
+                sync_matrix(&synced, rank, 0);
+                assert(matricesEqual(synced, full));
+                DistributedMatrix dist(full, numProcs);
+                assert(approxEqual(dist.sum(), full.sum(), 1e-8));
+
+                const int shapes = rank % 2 == 0 ? 3 : 1;
+                for (int extra = 0; extra < shapes; extra++) {
+                    Matrix row(1, cols * 3 + extra);
+                    row.fill(halfRank == 0 ? cols + extra : 0.0);
+                    sync_matrix(&row, halfRank, 0, half);
+                    assert(row.get(0, row.numCols() - 1) == cols + extra);
+                }
+            }
+        }
+        DistributedMatrix dist(Matrix(3, 5), halfSize, DistributedMatrix::Layout::Columns, 64, half);
+        assert(dist.sum() == 0.0);
+    }
+    MPI_Comm_free(&half);
+
+    if (rank == 0)
+        std::cout << "testCollectiveCachePerCommunicator passed." << std::endl;
+}
+
+void testPipelinedBroadcast() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    const int rows = 50, cols = 7;
+    Matrix expected(rows, cols);
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++)
+            expected.set(i, j, i * 100.0 + j);
+
+    const int src = numProcs - 1;
+    Matrix m = rank == src ? expected : Matrix(1, 1);
+    {
+        // Segments of 3 rows: the last one is shorter
+        MatrixBroadcast bcast(&m, rank, src, 3 * cols * sizeof(double));
+        assert(m.numRows() == rows && m.numCols() == cols);
+        assert(bcast.numSegments() == 17);
+        assert(bcast.segmentBegin(16) == 48 && bcast.segmentEnd(16) == rows);
+        for (int s = 0; s < bcast.numSegments(); s++) {
+            bcast.waitSegment(s);
+            assert(bcast.testSegment(s));
+            for (int i = bcast.segmentBegin(s); i < bcast.segmentEnd(s); i++)
+                for (int j = 0; j < cols; j++)
+                    assert(m.get(i, j) == expected.get(i, j));
+        }
+    }
+
+    // A segment larger than the matrix, and the destructor completing an unwaited broadcast
+    Matrix n = rank == 0 ? expected : Matrix(rows, cols);
+    {
+        MatrixBroadcast bcast(&n, rank, 0, 1L << 20);
+        assert(bcast.numSegments() == 1 && bcast.segmentEnd(0) == rows);
+    }
+    assert(matricesEqual(n, expected));
+
+    if (rank == 0)
+        std::cout << "testPipelinedBroadcast passed." << std::endl;
+}
+
+void testDataParallelGradientDescent() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    // Least squares y = x W + b on samples split equally among the processes
+    const int features = 3, outputs = 2, samplesPerProc = 4, steps = 20;
+    const double learningRate = 0.1;
+    auto sample = [&](int k, Matrix& x, Matrix& y, int row) {
+        for (int j = 0; j < features; j++)
+            x.set(row, j, std::sin(1.0 + k * features + j));
+        for (int j = 0; j < outputs; j++)
+            y.set(row, j, std::cos(2.0 + k * outputs + j));
+    };
+    // Mean over the rows of x of the gradients of (x W + b - y)^2 / 2
+    auto gradients = [&](const Matrix& x, const Matrix& y, const Matrix& w, const Matrix& b, Matrix& gradW, Matrix& gradB) {
+        Matrix residual = x * w - y;
+        for (int i = 0; i < residual.numRows(); i++)
+            for (int j = 0; j < outputs; j++)
+                residual.set(i, j, residual.get(i, j) + b.get(0, j));
+        gradW = x.transpose() * residual * (1.0 / x.numRows());
+        gradB.fill(0.0);
+        for (int i = 0; i < residual.numRows(); i++)
+            for (int j = 0; j < outputs; j++)
+                gradB.set(0, j, gradB.get(0, j) + residual.get(i, j) / x.numRows());
+    };
+
+    // Full-batch gradient descent on all the samples
+    Matrix allX(samplesPerProc * numProcs, features), allY(samplesPerProc * numProcs, outputs);
+    for (int k = 0; k < samplesPerProc * numProcs; k++)
+        sample(k, allX, allY, k);
+    Matrix expectedW(features, outputs), expectedB(1, outputs), gradW(features, outputs), gradB(1, outputs);
+    expectedW.fill(0.0);
+    expectedB.fill(0.0);
+    for (int step = 0; step < steps; step++) {
+        gradients(allX, allY, expectedW, expectedB, gradW, gradB);
+        expectedW.sub_mul(learningRate, gradW);
+        expectedB.sub_mul(learningRate, gradB);
+    }
+
+    Matrix x(samplesPerProc, features), y(samplesPerProc, outputs);
+    for (int k = 0; k < samplesPerProc; k++)
+        sample(rank * samplesPerProc + k, x, y, k);
+    // A bucket per gradient (reduced in place), then a single bucket for both
+    for (long bucketBytes : {8L, 1L << 20}) {
+        Matrix w(features, outputs), b(1, outputs);
+        w.fill(0.0);
+        b.fill(0.0);
+        // The bias gradient is the one ready first
+        dataParallelGradientDescent({&b, &w}, {&gradB, &gradW}, learningRate, steps, [&](GradientSynchronizer& sync) {
+            gradients(x, y, w, b, gradW, gradB);
+            sync.ready(0);
+            sync.ready(1);
+        }, bucketBytes);
+        assert(matricesEqual(w, expectedW, 1e-12));
+        assert(matricesEqual(b, expectedB, 1e-12));
+    }
+
+    GradientSynchronizer sync({&gradB, &gradW}, 8);
+    assert(sync.numBuckets() == 2);
+    sync.ready(1);
+    bool threw = false;
+    try {
+        sync.ready(1);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+    threw = false;
+    try {
+        sync.wait();
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+    sync.ready(0);
+    sync.wait();
+
+    if (rank == 0)
+        std::cout << "testDataParallelGradientDescent passed." << std::endl;
+}
+
+void testCompressedCollectives() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+    using Kind = CollectiveCompression::Kind;
+
+    // Small multiples of 1/4 are exact in 16 bits, and so are their sums
+    for (Kind kind : {Kind::None, Kind::Float16, Kind::BFloat16}) {
+        CollectiveCompression compression(kind);
+        std::vector<double> data = {0.25 * rank, -1.5, 2.0 + rank, 0.0};
+        compression.allreduce(data.data(), static_cast<long>(data.size()), MPI_COMM_WORLD);
+        const double ranks = numProcs * (numProcs - 1) / 2.0;
+        assert(data[0] == 0.25 * ranks && data[1] == -1.5 * numProcs && data[2] == 2.0 * numProcs + ranks && data[3] == 0.0);
+    }
+
+    // Half precision: largest finite value, overflow, smallest subnormal, rounding to 11 bits
+    CollectiveCompression half(Kind::Float16);
+    std::vector<double> values = {65504.0, 1e6, std::ldexp(1.0, -24), 1.0 + std::ldexp(1.0, -12)};
+    if (rank == 0)
+        half.broadcast(values.data(), static_cast<long>(values.size()), 0, MPI_COMM_WORLD);
+    else {
+        std::vector<double> received(values.size());
+        half.broadcast(received.data(), static_cast<long>(received.size()), 0, MPI_COMM_WORLD);
+        values = received;
+    }
+    assert(values[0] == 65504.0 && std::isinf(values[1]) && values[2] == std::ldexp(1.0, -24) && values[3] == 1.0);
+
+    // The compressed product stays within the precision of its kind
+    const int rows = 6, cols = 11;
+    Matrix a(rows, cols), b(rows + 1, cols);
+    for (int i = 0; i < rows + 1; i++)
+        for (int j = 0; j < cols; j++) {
+            if (i < rows)
+                a.set(i, j, std::sin(i * cols + j));
+            b.set(i, j, std::cos(i + j * 0.5));
+        }
+    DistributedMatrix distA(a, numProcs), distB(b, numProcs);
+    Matrix exact = a * b.transpose();
+    CollectiveCompression none(Kind::None), bfloat(Kind::BFloat16);
+    assert(matricesEqual(distA.multiplyTransposed(distB, none), exact, 1e-12));
+    assert(matricesEqual(distA.multiplyTransposed(distB, half), exact, cols * 2e-3));
+    assert(matricesEqual(distA.multiplyTransposed(distB, bfloat), exact, cols * 2e-2));
+
+    // Top-k: every process sends its largest element only, the others wait for the next reduction
+    CollectiveCompression topK(Kind::TopK, 0.25);
+    std::vector<double> sparse(4, 0.0);
+    sparse[rank % 4] = 10.0;
+    sparse[(rank + 1) % 4] = 1.0;
+    topK.allreduce(sparse.data(), 4, MPI_COMM_WORLD);
+    for (int k = 0; k < 4; k++) {
+        double expected = 0.0;
+        for (int p = 0; p < numProcs; p++)
+            expected += p % 4 == k ? 10.0 : 0.0;
+        assert(sparse[k] == expected);
+    }
+    std::fill(sparse.begin(), sparse.end(), 0.0);
+    topK.allreduce(sparse.data(), 4, MPI_COMM_WORLD);
+    for (int k = 0; k < 4; k++) {
+        double expected = 0.0;
+        for (int p = 0; p < numProcs; p++)
+            expected += (p + 1) % 4 == k ? 1.0 : 0.0;
+        assert(sparse[k] == expected);
+    }
+
+    // Compressed sync_matrix: the same values on every process, source included
+    Matrix synced(3, 3);
+    if (rank == numProcs - 1)
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                synced.set(i, j, 1.0 / (1 + i + j));
+    sync_matrix(&synced, rank, numProcs - 1, bfloat);
+    Matrix reference = synced;
+    sync_matrix(&reference, rank, 0);
+    assert(matricesEqual(synced, reference, 0.5e-15));
+    assert(std::fabs(synced.get(2, 2) - 0.2) < 1e-3);
+
+    bool threw = false;
+    try {
+        topK.broadcast(sparse.data(), 4, 0, MPI_COMM_WORLD);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    if (rank == 0)
+        std::cout << "testCompressedCollectives passed." << std::endl;
+}
+
+void testSubCommunicators() {
+    int rank, numProcs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+
+    // Two groups (even and odd ranks, then the first process and the others), each with its own
+    // matrices; the second split may reuse the handle of the first communicator once freed
+    for (int split = 0; split < 2; split++) {
+        const int color = split == 0 ? rank % 2 : (rank == 0 ? 0 : 1);
+        MPI_Comm group;
+        MPI_Comm_split(MPI_COMM_WORLD, color, rank, &group);
+        int groupRank, groupSize;
+        MPI_Comm_rank(group, &groupRank);
+        MPI_Comm_size(group, &groupSize);
+
+        { // The matrices of a communicator must not outlive it
+            const int rows = 7 + color, cols = 9;
+            Matrix a(rows, cols), b(rows, cols);
+            for (int i = 0; i < rows; i++)
+                for (int j = 0; j < cols; j++) {
+                    a.set(i, j, (color + 1) * (i * cols + j));
+                    b.set(i, j, std::sin(i + j + color));
+                }
+            for (auto layout : {DistributedMatrix::Layout::Columns, DistributedMatrix::Layout::BlockCyclic}) {
+                DistributedMatrix distA(a, groupSize, layout, 2, group), distB(b, groupSize, layout, 2, group);
+                assert(distA.getGrid().rows * distA.getGrid().cols == groupSize);
+                assert(approxEqual(distA.sum(), a.sum(), 1e-9));
+                assert(matricesEqual(distA.gather(), a));
+                assert(matricesEqual((distA + distB).gather(), a + b));
+                assert(matricesEqual(distA.multiplyTransposed(distB), a * b.transpose(), 1e-9));
+            }
+
+            Matrix synced = groupRank == groupSize - 1 ? a : Matrix(1, 1);
+            sync_matrix(&synced, groupRank, groupSize - 1, group);
+            assert(matricesEqual(synced, a));
+            NodeSharedMatrix shared(a, 0, group);
+            DistributedMatrix distB(b.transpose(), groupSize, DistributedMatrix::Layout::Columns, 64, group);
+            assert(matricesEqual(multiply(shared, distB).gather(), a * b.transpose(), 1e-9));
+        }
+        MPI_Comm_free(&group);
+    }
+
+    if (rank == 0)
+        std::cout << "testSubCommunicators passed." << std::endl;
+}
+
 int main(int argc, char** argv) {
     int initialized;
     MPI_Initialized(&initialized);
-    if (!initialized)
-        MPI_Init(&argc, &argv);
+    if (!initialized) {
+        // The local Matrix operations may run on OpenMP threads, MPI is only called by this one
+        int provided;
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    }
 
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -334,13 +1340,32 @@ int main(int argc, char** argv) {
         testColumnDistribution();
         testApply();
         testApplyBinary();
+        testInPlaceElementwise();
         testMultiply();
         testMultiplyTransposed();
+        testMultiplyTransposedDistributed();
         testSum();
         testGather();
+        testGatherTo();
+        testWriteCollective();
+        testReadCollective();
+        testAsyncCheckpoint();
+        testPartitioners();
+        testNodeShared();
+        testRowLayout();
+        testTSQR();
         testGetAndSet();
+        testRemoteAccess();
         testCopyConstructor();
         testCommonOperations();
+        testBlockCyclicLayout();
+        testDistributedProduct();
+        testRepeatedCollectives();
+        testCollectiveCachePerCommunicator();
+        testPipelinedBroadcast();
+        testDataParallelGradientDescent();
+        testCompressedCollectives();
+        testSubCommunicators();
 
         if (rank == 0)
             std::cout << "All distributed matrix tests passed." << std::endl;
@@ -1,6 +1,11 @@
 #include <cassert>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 #include "matrix.hpp"
 
@@ -168,6 +173,146 @@ void testSubMul()
     std::cout << "testSubMul passed." << std::endl;
 }
 
+Matrix patternMatrix(int rows, int cols, double seed)
+{
+    Matrix m(rows, cols);
+    for (int i = 0; i < rows; ++i)
+        for (int j = 0; j < cols; ++j)
+            m.set(i, j, std::sin(seed + 0.37 * i + 0.11 * j));
+    return m;
+}
+
+void testKernelDispatch()
+{
+    // Odd sizes exercise the borders of the GEMM micro-kernels and of the transpose tiles
+    const int m = 37, k = 53, n = 29;
+    Matrix a = patternMatrix(m, k, 0.5);
+    Matrix b = patternMatrix(k, n, 1.5);
+    Matrix c = patternMatrix(m, k, 2.5);
+
+    Matrix product(m, n);
+    for (int i = 0; i < m; ++i)
+        for (int j = 0; j < n; ++j)
+        {
+            double s = 0.0;
+            for (int p = 0; p < k; ++p)
+                s += a.get(i, p) * b.get(p, j);
+            product.set(i, j, s);
+        }
+    double total = 0.0;
+    for (int i = 0; i < m; ++i)
+        for (int p = 0; p < k; ++p)
+            total += a.get(i, p);
+
+    const std::string initial = Matrix::kernelISA();
+    assert(!Matrix::useKernelISA("no-such-isa"));
+    assert(Matrix::kernelISA() == initial);
+
+    for (const char *isa : {"generic", "sse2", "avx2", "avx512"})
+    {
+        if (!Matrix::useKernelISA(isa))
+            continue; // Not supported by this CPU
+        assert(Matrix::kernelISA() == std::string(isa));
+
+        assert(matricesEqual(a * b, product, 1e-9));
+        assert(matricesEqual(a.transpose().transpose(), a, 1e-15));
+        Matrix t = a.transpose();
+        for (int i = 0; i < m; ++i)
+            for (int p = 0; p < k; ++p)
+                assert(t.get(p, i) == a.get(i, p));
+
+        Matrix sum = a + c, difference = a - c, scaled = a * 3.0, updated = a;
+        updated.sub_mul(0.5, c);
+        Matrix filled(m, k);
+        filled.fill(4.0);
+        for (int i = 0; i < m; ++i)
+            for (int p = 0; p < k; ++p)
+            {
+                assert(approxEqual(sum.get(i, p), a.get(i, p) + c.get(i, p), 1e-12));
+                assert(approxEqual(difference.get(i, p), a.get(i, p) - c.get(i, p), 1e-12));
+                assert(approxEqual(scaled.get(i, p), 3.0 * a.get(i, p), 1e-12));
+                assert(approxEqual(updated.get(i, p), a.get(i, p) - 0.5 * c.get(i, p), 1e-12));
+                assert(filled.get(i, p) == 4.0);
+            }
+        assert(approxEqual(a.sum(), total, 1e-9));
+    }
+    Matrix::useKernelISA(initial);
+
+    std::cout << "testKernelDispatch passed." << std::endl;
+}
+
+void testGemmTuning()
+{
+    const int m = 45, k = 70, n = 33;
+    Matrix a = patternMatrix(m, k, 0.25);
+    Matrix b = patternMatrix(k, n, 0.75);
+    Matrix reference = a * b;
+
+    // Every blocking, including blocks smaller than the micro-kernel, gives the same product
+    const Matrix::GemmTuning initial = Matrix::gemmTuning();
+    for (int kernel = 0; kernel < 2; ++kernel)
+        for (int block : {1, 7, 64})
+        {
+            Matrix::GemmTuning tuning;
+            tuning.mc = block;
+            tuning.kc = block;
+            tuning.nc = block;
+            tuning.microKernel = kernel;
+            tuning.threads = kernel + 1;
+            try
+            {
+                Matrix::setGemmTuning(tuning);
+            }
+            catch (const std::invalid_argument &)
+            {
+                continue; // Only one micro-kernel for this instruction set
+            }
+            assert(matricesEqual(a * b, reference, 1e-9));
+        }
+
+    Matrix::GemmTuning invalid;
+    invalid.kc = 0;
+    bool thrown = false;
+    try
+    {
+        Matrix::setGemmTuning(invalid);
+    }
+    catch (const std::invalid_argument &)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // The tuning is persisted per host and instruction set, and loaded back
+    const std::string file = "test_matrix_gemm_tuning.txt";
+    std::remove(file.c_str());
+    setenv("MATRIX_TUNING_FILE", file.c_str(), 1);
+    assert(Matrix::gemmTuningFile() == file);
+    const std::string isa = Matrix::kernelISA();
+    const Matrix::GemmTuning tuned = Matrix::autotuneGemm(96);
+    assert(matricesEqual(a * b, reference, 1e-9));
+
+    std::ifstream in(file);
+    std::string line;
+    assert(std::getline(in, line) && line.compare(0, isa.size() + 1, isa + " ") == 0);
+    assert(!std::getline(in, line));
+
+    const char *other = isa == "generic" ? "sse2" : "generic";
+    if (Matrix::useKernelISA(other))
+    {
+        Matrix::useKernelISA(isa);
+        const Matrix::GemmTuning loaded = Matrix::gemmTuning();
+        assert(loaded.mc == tuned.mc && loaded.kc == tuned.kc && loaded.nc == tuned.nc);
+        assert(loaded.microKernel == tuned.microKernel && loaded.threads == tuned.threads);
+    }
+
+    std::remove(file.c_str());
+    unsetenv("MATRIX_TUNING_FILE");
+    Matrix::setGemmTuning(initial);
+
+    std::cout << "testGemmTuning passed." << std::endl;
+}
+
 int main()
 {
     testConstructorsAndAccessors();
@@ -177,6 +322,8 @@ int main()
     testTranspose();
     testApply();
     testSubMul();
+    testKernelDispatch();
+    testGemmTuning();
 
     std::cout << "All matrix tests passed." << std::endl;
     return 0;